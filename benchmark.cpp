@@ -0,0 +1,392 @@
+// headless latency benchmark of the update pipeline, from Update / UpdateRows to the visible rows
+// refreshed (frameShown) and painted. QT_QPA_PLATFORM is offscreen unless set, one JSON object is
+// printed on stdout:
+//   spread_sheet_benchmark [--rows N] [--rate HZ] [--change RATIO] [--sort-column C] [--descend]
+//                          [--sort-keys C,-C..] [--roi N] [--seconds S] [--visible-sort] [--replay FILE [--speed X]]
+//                          [--scroll ROWS] [--default-delegate] [--highlight MS] [--history N]
+// change 1 publishes whole tables, less than 1 patches that part of the rows with UpdateRows.
+// sort-keys sorts by several columns instead of sort-column, e.g. 1,-3: v1 ascending then v3 descending.
+// replay publishes the frames of a log recorded with SpreadSheet::startRecording (main --record) instead,
+// at the recorded pace times speed (0 as fast as possible), until the log or the seconds end.
+// scroll moves the table down by ROWS rows 60 times a second meanwhile, back to the top at the end.
+// at the end the viewport is repainted in full 100 times (repaint_ms), default-delegate paints the
+// cells with QStyledItemDelegate instead of the CellDelegate of the sheet to compare.
+// highlight tints the changed cells for MS milliseconds (SpreadSheet::setChangeHighlight), history keeps
+// the last N values of every row and shows the sparkline column (SpreadSheet::setRowHistory)
+#include <QtWidgets/QApplication>
+#include <QMainWindow>
+#include <QTableView>
+#include <QHeaderView>
+#include <QScrollBar>
+#include <QStyledItemDelegate>
+#include <QTimer>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spread_sheet.h"
+#include "frame_log.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    typedef struct Options {
+        int rows = 102400;
+        double rate = 60;// updates per second
+        double change = 1.0;// part of the rows changed per update
+        int sort_column = 1;
+        bool descend = false;
+        std::string sort_keys;// several columns, a minus sign for descending
+        int roi = 0;// rows of interest, 0 shows all rows
+        double seconds = 10;
+        bool visible_sort = false;
+        std::string replay;// frame log to play instead of the synthetic producer
+        double speed = 1.0;
+        int scroll = 0;// rows scrolled per display frame, 0 does not scroll
+        bool default_delegate = false;
+        int highlight = 0;// fade of the change highlight, 0 is off
+        int history = 0;// values per row of the sparkline column, 0 is off
+    }Options;
+
+    // "1,-3" as v1 ascending then v3 descending
+    tool::SortKeys parse_sort_keys(const std::string& text)
+    {
+        tool::SortKeys keys;
+        size_t begin = 0;
+        while (begin < text.size())
+        {
+            size_t end = text.find(',', begin);
+            if (std::string::npos == end)
+                end = text.size();
+            std::string item = text.substr(begin, end - begin);
+            tool::SortKey key;
+            key.ascend = (item.empty() || '-' != item[0]);
+            key.column = std::atoi(item.c_str() + (key.ascend ? 0 : 1));
+            keys.push_back(key);
+            begin = end + 1;
+        }
+        return keys;
+    }
+
+    bool parse_options(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+            if ("--descend" == arg)
+                options.descend = true;
+            else if ("--visible-sort" == arg)
+                options.visible_sort = true;
+            else if ("--default-delegate" == arg)
+                options.default_delegate = true;
+            else if (!value)
+                return false;
+            else if ("--rows" == arg)
+                options.rows = std::atoi(argv[++i]);
+            else if ("--rate" == arg)
+                options.rate = std::atof(argv[++i]);
+            else if ("--change" == arg)
+                options.change = std::atof(argv[++i]);
+            else if ("--sort-column" == arg)
+                options.sort_column = std::atoi(argv[++i]);
+            else if ("--sort-keys" == arg)
+                options.sort_keys = argv[++i];
+            else if ("--roi" == arg)
+                options.roi = std::atoi(argv[++i]);
+            else if ("--seconds" == arg)
+                options.seconds = std::atof(argv[++i]);
+            else if ("--replay" == arg)
+                options.replay = argv[++i];
+            else if ("--speed" == arg)
+                options.speed = std::atof(argv[++i]);
+            else if ("--scroll" == arg)
+                options.scroll = std::atoi(argv[++i]);
+            else if ("--highlight" == arg)
+                options.highlight = std::atoi(argv[++i]);
+            else if ("--history" == arg)
+                options.history = std::atoi(argv[++i]);
+            else
+                return false;
+        }
+        return (options.rows > 0) && (options.rate > 0) && (options.seconds > 0) && (options.speed >= 0);
+    }
+
+    // latency of every published update, taken on the GUI thread
+    class Recorder : public QObject
+    {
+    public:
+        // f publishes and returns the sequence, the lock keeps frameShown from seeing it before it is recorded
+        template <typename F>
+        void publish(F f)
+        {
+            std::lock_guard<std::mutex> lock(this->lock_);
+            Clock::time_point now = Clock::now();
+            unsigned long long sequence = f();
+            if (sequence)
+                this->pending_.push_back({ sequence, now });
+            this->published_++;
+        }
+
+        // every update up to sequence is on screen, the ones shown in the same frame were coalesced
+        void shown(unsigned long long sequence)
+        {
+            std::lock_guard<std::mutex> lock(this->lock_);
+            Clock::time_point now = Clock::now();
+            size_t count = 0;
+            while (!this->pending_.empty() && this->pending_.front().first <= sequence)
+            {
+                this->update_ms_.push_back(ms(now - this->pending_.front().second));
+                this->unpainted_.push_back(this->pending_.front().second);
+                this->pending_.pop_front();
+                count++;
+            }
+            if (!count)
+                return;
+            this->frames_++;
+            this->dropped_ += count - 1;
+        }
+
+        // the viewport paints the refreshed rows
+        virtual bool eventFilter(QObject* watched, QEvent* event)
+        {
+            if (QEvent::Paint == event->type())
+            {
+                std::lock_guard<std::mutex> lock(this->lock_);
+                Clock::time_point now = Clock::now();
+                for (auto& t : this->unpainted_)
+                    this->paint_ms_.push_back(ms(now - t));
+                this->unpainted_.clear();
+            }
+            return QObject::eventFilter(watched, event);
+        }
+
+        // one full repaint of the viewport, painted synchronously
+        void repainted(double ms)
+        {
+            std::lock_guard<std::mutex> lock(this->lock_);
+            this->repaint_ms_.push_back(ms);
+        }
+
+        void print(const Options& options, double cpu_ms)
+        {
+            std::lock_guard<std::mutex> lock(this->lock_);
+            printf("{\"rows\": %d, \"rate\": %g, \"change\": %g, \"sort_column\": %d, \"descend\": %s, \"sort_keys\": \"%s\", \"roi\": %d, \"seconds\": %g, "
+                "\"visible_sort\": %s, \"replay\": %s, \"scroll\": %d, \"default_delegate\": %s, \"highlight\": %d, \"history\": %d, \"published\": %llu, \"frames\": %llu, \"dropped\": %llu, ",
+                options.rows, options.rate, options.change, options.sort_column, options.descend ? "true" : "false", options.sort_keys.c_str(),
+                options.roi, options.seconds, options.visible_sort ? "true" : "false", options.replay.size() ? "true" : "false",
+                options.scroll, options.default_delegate ? "true" : "false", options.highlight, options.history, this->published_, this->frames_, this->dropped_);
+            printLatency("update_latency_ms", this->update_ms_);
+            printf(", ");
+            printLatency("paint_latency_ms", this->paint_ms_);
+            printf(", ");
+            printLatency("repaint_ms", this->repaint_ms_);
+            printf(", \"cpu_ms_per_frame\": %.3f}\n", this->frames_ ? cpu_ms / this->frames_ : 0.0);
+            fflush(stdout);
+        }
+
+    private:
+        static double ms(Clock::duration d)
+        {
+            return std::chrono::duration<double, std::milli>(d).count();
+        }
+
+        static void printLatency(const char* name, std::vector<double>& values)
+        {
+            std::sort(values.begin(), values.end());
+            auto at = [&values](double q) {
+                return values.empty() ? 0.0 : values[std::min(values.size() - 1, (size_t)(q * values.size()))];
+            };
+            printf("\"%s\": {\"count\": %zu, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+                name, values.size(), at(0.5), at(0.99), values.empty() ? 0.0 : values.back());
+        }
+
+        std::mutex lock_;
+        std::deque<std::pair<unsigned long long, Clock::time_point> > pending_;
+        std::vector<Clock::time_point> unpainted_;
+        std::vector<double> update_ms_;
+        std::vector<double> paint_ms_;
+        std::vector<double> repaint_ms_;
+        unsigned long long published_ = 0;
+        unsigned long long frames_ = 0;
+        unsigned long long dropped_ = 0;
+    };
+
+    void fill_row(tool::ColumnTable& table, size_t row, std::mt19937& gen, std::uniform_int_distribution<>& distrib)
+    {
+        table.column(0).values<int32_t>()[row] = (int32_t)row;
+        table.column(1).values<int32_t>()[row] = distrib(gen);
+        table.column(2).values<int32_t>()[row] = distrib(gen);
+        table.column(3).values<float>()[row] = (float)distrib(gen);
+    }
+
+    // the frames of options.replay, each one timed like a synthetic one
+    void replay(tool::SpreadSheet* ss, Recorder* recorder, const Options& options, std::atomic<bool>* stop)
+    {
+        tool::FrameLogReader log;
+        if (!log.open(options.replay))
+        {
+            fprintf(stderr, "%s: %s\n", options.replay.c_str(), log.error().c_str());
+            return;
+        }
+
+        tool::FrameLogTarget target;
+        target.acquire = [ss](const tool::Schema& schema, size_t rows) { return ss->acquireTable(schema, rows); };
+        target.update = [ss, recorder](tool::ColumnTablePtr& table) {
+            recorder->publish([&]() {
+                ss->Update(table);
+                return table->sequence();
+            });
+        };
+        target.updateRows = [ss, recorder](const tool::RowPatch* rows, size_t count) {
+            recorder->publish([&]() {
+                return ss->UpdateRows(rows, count);
+            });
+        };
+        tool::replay_frame_log(log, options.speed, *stop, target);
+    }
+
+    // synthetic producer like the one of main.cpp, at a fixed rate
+    void produce(tool::SpreadSheet* ss, Recorder* recorder, const Options& options, std::atomic<bool>* stop)
+    {
+        std::mt19937 gen(1);
+        std::uniform_int_distribution<> distrib(1, options.rows);
+        std::uniform_int_distribution<> rows(0, options.rows - 1);
+        std::vector<tool::RowPatch> patches;
+        Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.rate));
+        Clock::time_point next = Clock::now();
+        bool first = true;
+        while (!*stop)
+        {
+            if (first || options.change >= 1.0)
+            {
+                tool::ColumnTablePtr table = ss->acquireTable(tool::ColumnTable::legacySchema(), options.rows);
+                for (int i = 0; i < options.rows; i++)
+                    fill_row(*table, i, gen, distrib);
+                recorder->publish([&]() {
+                    ss->Update(table);
+                    return table->sequence();
+                });
+                first = false;
+            }
+            else
+            {
+                patches.resize(std::max<size_t>(1, (size_t)(options.rows * options.change)));
+                for (auto& it : patches)
+                {
+                    it.row = rows(gen);
+                    it.data.idx = it.row;
+                    it.data.v1 = distrib(gen);
+                    it.data.v2 = distrib(gen);
+                    it.data.v3 = (float)distrib(gen);
+                }
+                recorder->publish([&]() {
+                    return ss->UpdateRows(patches);
+                });
+            }
+
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        fprintf(stderr, "usage: %s [--rows N] [--rate HZ] [--change RATIO] [--sort-column C] [--descend] "
+            "[--sort-keys C,-C..] [--roi N] [--seconds S] [--visible-sort] [--replay FILE [--speed X]] [--scroll ROWS]\n"
+            "       [--default-delegate] [--highlight MS] [--history N]\n", argv[0]);
+        return 1;
+    }
+
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication a(argc, argv);
+
+    QMainWindow* w = new QMainWindow(NULL);
+    tool::SpreadSheet* ss = new tool::SpreadSheet(options.rows, 4, w);
+    ss->setSortMode(options.visible_sort ? tool::SpreadSheet::SortVisibleRows : tool::SpreadSheet::SortAllRows);
+    ss->setChangeHighlight(options.highlight);
+    ss->setRowHistory(options.history, options.rows);
+    w->setCentralWidget(ss);
+    w->resize(800, 600);
+    w->show();
+
+    if (options.sort_keys.size())
+        ss->setSortKeys(parse_sort_keys(options.sort_keys));
+    else
+        ss->setSortKeys({ { options.sort_column, !options.descend } });
+
+    if (options.roi > 0)
+    {
+        std::vector<int> roi(options.rows);
+        for (int i = 0; i < options.rows; i++)
+            roi[i] = i;
+        std::shuffle(roi.begin(), roi.end(), std::mt19937(2));
+        roi.resize(std::min(options.roi, options.rows));
+        ss->updatePoiRegion(std::move(roi));
+    }
+
+    Recorder recorder;
+    QTableView* view = ss->findChild<QTableView*>("tableView");
+    if (view)
+        view->viewport()->installEventFilter(&recorder);
+    if (view && options.default_delegate)
+        view->setItemDelegate(new QStyledItemDelegate(view));
+    QObject::connect(ss, &tool::SpreadSheet::frameShown, [&recorder](unsigned long long sequence) {
+        recorder.shown(sequence);
+    });
+
+    // a fling through the table, the rows scrolled in are painted from the prefetched band
+    QTimer scroller;
+    if (view && options.scroll > 0)
+    {
+        QObject::connect(&scroller, &QTimer::timeout, [view, &options]() {
+            QScrollBar* bar = view->verticalScrollBar();
+            int value = bar->value() + options.scroll;
+            bar->setValue((value > bar->maximum()) ? 0 : value);
+        });
+        scroller.start(1000 / 60);
+    }
+
+    std::atomic<bool> stop(false);
+    std::clock_t cpu_start = std::clock();// process time, the producer included
+    std::thread producer(options.replay.size() ? replay : produce, ss, &recorder, std::cref(options), &stop);
+
+    QTimer::singleShot((int)(options.seconds * 1000), [&]() {
+        stop = true;
+        producer.join();
+        double cpu_ms = 1000.0 * (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        scroller.stop();
+        for (int i = 0; view && i < 100; i++)
+        {
+            Clock::time_point start = Clock::now();
+            view->viewport()->repaint();
+            recorder.repainted(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        recorder.print(options, cpu_ms);
+        QApplication::quit();
+    });
+
+    int ret = a.exec();
+    if (producer.joinable())
+    {
+        stop = true;
+        producer.join();
+    }
+    delete w;
+    return ret;
+}
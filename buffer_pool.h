@@ -0,0 +1,88 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace tool
+{
+    typedef struct BufferPoolStats {
+        unsigned long long hits = 0;// acquired without allocation
+        unsigned long long misses = 0;// a new buffer or a larger capacity was allocated
+        size_t pooled = 0;// buffers waiting for reuse
+    }BufferPoolStats;
+
+    // recycles buffers (anything with resize() and capacity()), an acquired buffer goes back
+    // to the pool when its last shared_ptr is released. Thread safe.
+    template <typename T>
+    class BufferPool : public std::enable_shared_from_this<BufferPool<T> >
+    {
+    public:
+        using Ptr = std::shared_ptr<T>;
+
+        BufferPool(size_t max_pooled = 8) : max_pooled_(max_pooled), hits_(0), misses_(0) {}
+
+        // buffer resized to size, the old contents are not cleared
+        Ptr acquire(size_t size)
+        {
+            std::unique_ptr<T> buffer;
+            {
+                std::lock_guard<std::mutex> lock(this->lock_);
+                if (!this->free_.empty())
+                {
+                    buffer = std::move(this->free_.back());
+                    this->free_.pop_back();
+                }
+            }
+
+            if (buffer && buffer->capacity() >= size)
+                this->hits_++;
+            else
+                this->misses_++;
+            if (!buffer)
+                buffer.reset(new T());
+            buffer->resize(size);
+
+            // the pool may be gone when the buffer is released, then it is just deleted
+            std::weak_ptr<BufferPool<T> > pool = this->shared_from_this();
+            return Ptr(buffer.release(), [pool](T* p) {
+                std::shared_ptr<BufferPool<T> > owner = pool.lock();
+                if (owner)
+                    owner->release(p);
+                else
+                    delete p;
+            });
+        }
+
+        BufferPoolStats stats() const
+        {
+            BufferPoolStats s;
+            s.hits = this->hits_.load();
+            s.misses = this->misses_.load();
+            {
+                std::lock_guard<std::mutex> lock(this->lock_);
+                s.pooled = this->free_.size();
+            }
+            return s;
+        }
+
+    private:
+        void release(T* p)
+        {
+            std::unique_ptr<T> buffer(p);
+            std::lock_guard<std::mutex> lock(this->lock_);
+            if (this->free_.size() < this->max_pooled_)
+                this->free_.push_back(std::move(buffer));
+        }
+
+        size_t max_pooled_;
+        mutable std::mutex lock_;
+        std::vector<std::unique_ptr<T> > free_;
+        std::atomic<unsigned long long> hits_;
+        std::atomic<unsigned long long> misses_;
+    };
+}
+
+#endif // BUFFER_POOL_H
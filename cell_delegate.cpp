@@ -0,0 +1,202 @@
+#include "cell_delegate.h"
+#include <QApplication>
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QStyle>
+#include <QStyleOption>
+#include <algorithm>
+#include <cmath>
+#include "table_model.h"
+
+namespace tool
+{
+    namespace
+    {
+        // the palette group the default delegate paints option with
+        QPalette::ColorGroup color_group(const QStyleOptionViewItem& option)
+        {
+            if (!(option.state & QStyle::State_Enabled))
+                return QPalette::Disabled;
+            return (option.state & QStyle::State_Active) ? QPalette::Normal : QPalette::Inactive;
+        }
+    }
+
+    CellDelegate::CellDelegate(const TableModel* model, QObject* parent)
+        : QStyledItemDelegate(parent)
+        , model_(model)
+        , change_color_(255, 200, 0)
+    {
+        this->advances_.fill(-1.0);
+    }
+
+    CellDelegate::~CellDelegate()
+    {
+    }
+
+    void CellDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+    {
+        // a text cell with a background of the model goes to the default delegate, the sparkline is drawn
+        // on it. the alternate rows are painted by the view before the delegate (PE_PanelItemViewRow)
+        QVariant background = index.data(Qt::BackgroundRole);
+        if (paintHistory(painter, option, index, background))
+        {
+            paintFocus(painter, option);
+            return;
+        }
+        paintChange(painter, option, index);
+
+        const char* text = nullptr;
+        int size = 0;
+        if (background.isValid() || !this->model_->cellText(index.row(), index.column(), text, size))
+        {
+            QStyledItemDelegate::paint(painter, option, index);
+            return;
+        }
+        if (!this->font_set_ || (option.font != this->font_))
+            setFont(option.font, option.widget);
+
+        QPalette::ColorGroup group = color_group(option);
+        bool selected = (option.state & QStyle::State_Selected);
+        if (selected)
+            painter->fillRect(option.rect, option.palette.brush(group, QPalette::Highlight));
+
+        // left aligned and vertically centred like the default delegate, characters past the cell are left out
+        qreal x = option.rect.left() + this->margin_;
+        qreal right = option.rect.right() + 1 - this->margin_;
+        qreal y = option.rect.top() + (option.rect.height() - this->height_) / 2.0;
+
+        QPen pen = painter->pen();
+        QFont font = painter->font();
+        painter->setPen(option.palette.color(group, selected ? QPalette::HighlightedText : QPalette::Text));
+        painter->setFont(this->font_);
+        for (int i = 0; i < size; i++)
+        {
+            unsigned char c = (unsigned char)text[i];
+            if (c >= this->glyphs_.size())
+                continue;
+            const QStaticText& g = glyph(c);
+            if (x + this->advances_[c] > right)
+                break;
+            painter->drawStaticText(QPointF(x, y), g);
+            x += this->advances_[c];
+        }
+        painter->setFont(font);
+        painter->setPen(pen);
+        paintFocus(painter, option);
+    }
+
+    void CellDelegate::setChangeHighlight(int fade_ms, const QColor& color)
+    {
+        this->fade_ms_ = std::max(0, fade_ms);
+        this->change_color_ = color;
+    }
+
+    void CellDelegate::paintChange(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+    {
+        if (!this->fade_ms_ || (option.state & QStyle::State_Selected))
+            return;
+        uint32_t changed = this->model_->cellChange(index.row(), index.column());
+        if (!changed)
+            return;
+        uint32_t age = change_clock_ms() - changed;
+        if (age >= (uint32_t)this->fade_ms_)
+            return;
+
+        QColor tint = this->change_color_;
+        tint.setAlphaF(tint.alphaF() * (1.0 - (qreal)age / this->fade_ms_));
+        painter->fillRect(option.rect, tint);
+    }
+
+    bool CellDelegate::paintHistory(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index, const QVariant& background) const
+    {
+        const float* values = nullptr;
+        int size = 0;
+        if (!this->model_->cellHistory(index.row(), index.column(), values, size))
+            return false;
+
+        QPalette::ColorGroup group = color_group(option);
+        bool selected = (option.state & QStyle::State_Selected);
+        if (background.isValid())
+            painter->fillRect(option.rect, background.value<QBrush>());
+        paintChange(painter, option, index);
+        if (selected)
+            painter->fillRect(option.rect, option.palette.brush(group, QPalette::Highlight));
+
+        // NaN and infinite values are left out of the range, they are drawn on the middle line
+        float low = 0.0f;
+        float high = 0.0f;
+        bool found = false;
+        for (int i = 0; i < size; i++)
+        {
+            if (!std::isfinite(values[i]))
+                continue;
+            low = found ? std::min(low, values[i]) : values[i];
+            high = found ? std::max(high, values[i]) : values[i];
+            found = true;
+        }
+
+        qreal left = option.rect.left() + 2;
+        qreal width = std::max(1, option.rect.width() - 4);
+        qreal top = option.rect.top() + 3;
+        qreal height = std::max(1, option.rect.height() - 6);
+        qreal step = (size > 1) ? width / (size - 1) : 0.0;
+        this->points_.resize(size);
+        for (int i = 0; i < size; i++)
+        {
+            qreal y = 0.5;
+            if (std::isfinite(values[i]) && (high > low))
+                y = 1.0 - (qreal)(values[i] - low) / (high - low);
+            this->points_[i] = QPointF(left + i * step, top + y * height);
+        }
+
+        QPen pen = painter->pen();
+        painter->setPen(option.palette.color(group, selected ? QPalette::HighlightedText : QPalette::Text));
+        if (1 == size)
+            painter->drawPoint(this->points_[0]);
+        else
+            painter->drawPolyline(this->points_.data(), size);
+        painter->setPen(pen);
+        return true;
+    }
+
+    void CellDelegate::paintFocus(QPainter* painter, const QStyleOptionViewItem& option) const
+    {
+        if (!(option.state & QStyle::State_HasFocus))
+            return;
+
+        // as the default delegate draws it
+        const QStyle* style = option.widget ? option.widget->style() : QApplication::style();
+        QStyleOptionFocusRect focus;
+        focus.QStyleOption::operator=(option);
+        focus.state |= QStyle::State_KeyboardFocusChange;
+        focus.state |= QStyle::State_Item;
+        bool selected = (option.state & QStyle::State_Selected);
+        focus.backgroundColor = option.palette.color(color_group(option), selected ? QPalette::Highlight : QPalette::Window);
+        style->drawPrimitive(QStyle::PE_FrameFocusRect, &focus, painter, option.widget);
+    }
+
+    void CellDelegate::setFont(const QFont& font, const QWidget* widget) const
+    {
+        const QStyle* style = widget ? widget->style() : QApplication::style();
+        this->font_ = font;
+        this->font_set_ = true;
+        this->height_ = QFontMetricsF(font).height();
+        this->margin_ = style->pixelMetric(QStyle::PM_FocusFrameHMargin, nullptr, widget) + 1;
+        this->advances_.fill(-1.0);
+    }
+
+    const QStaticText& CellDelegate::glyph(unsigned char c) const
+    {
+        QStaticText& g = this->glyphs_[c];
+        if (this->advances_[c] < 0.0)
+        {
+            QChar ch = QChar::fromLatin1((char)c);
+            g.setTextFormat(Qt::PlainText);
+            g.setPerformanceHint(QStaticText::AggressiveCaching);
+            g.setText(QString(ch));
+            g.prepare(QTransform(), this->font_);
+            this->advances_[c] = QFontMetricsF(this->font_).horizontalAdvance(ch);
+        }
+        return g;
+    }
+}
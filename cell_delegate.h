@@ -0,0 +1,67 @@
+#ifndef CELL_DELEGATE_H
+#define CELL_DELEGATE_H
+
+#include <QColor>
+#include <QFont>
+#include <QStaticText>
+#include <QStyledItemDelegate>
+#include <array>
+#include <vector>
+
+namespace tool
+{
+    class TableModel;
+
+    // paints the number cells of the page on display without a QString per cell (the one QVariant, the
+    // BackgroundRole, is empty from TableModel): the text comes formatted with the page (TableModel::cellText),
+    // each character is drawn from a glyph laid out once for the font. other cells (strings, rows out of
+    // the page, cells with a BackgroundRole) go to QStyledItemDelegate.
+    // cells the page marks changed (TableModel::cellChange) get a tint fading out over fade ms, the
+    // history column is a sparkline of the values of the page (TableModel::cellHistory)
+    class CellDelegate : public QStyledItemDelegate
+    {
+    public:
+        CellDelegate(const TableModel* model, QObject* parent = 0);
+        ~CellDelegate();
+
+        virtual void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const;
+
+        // tint of a changed cell, full color when it changed, gone fade_ms later. 0 paints no tint
+        void setChangeHighlight(int fade_ms, const QColor& color);
+        int changeFade() const { return fade_ms_; }
+        const QColor& changeColor() const { return change_color_; }
+
+    private:
+        // the tint of the cell at index if it changed less than fade_ms_ ago
+        void paintChange(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const;
+
+        // the values of the history column as a line from the oldest to the newest over the cell, on
+        // background (the BackgroundRole of index) if valid, scaled to their own range. false if the
+        // cell has no history
+        bool paintHistory(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index, const QVariant& background) const;
+
+        // the focus frame of the current cell, as the default delegate draws it
+        void paintFocus(QPainter* painter, const QStyleOptionViewItem& option) const;
+
+        // the glyphs of another font are laid out again when drawn
+        void setFont(const QFont& font, const QWidget* widget) const;
+
+        // the glyph of an ASCII character, laid out the first time it is drawn
+        const QStaticText& glyph(unsigned char c) const;
+
+        const TableModel* model_;
+        int fade_ms_ = 0;
+        QColor change_color_;
+
+        // glyph cache of the font of the last paint, paint is const
+        mutable QFont font_;
+        mutable bool font_set_ = false;
+        mutable qreal height_ = 0.0;
+        mutable int margin_ = 0;// left and right of the text, as the style gives the default delegate
+        mutable std::array<QStaticText, 128> glyphs_;
+        mutable std::array<qreal, 128> advances_;// negative until laid out
+        mutable std::vector<QPointF> points_;// of the last sparkline
+    };
+}
+
+#endif // CELL_DELEGATE_H
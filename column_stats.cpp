@@ -0,0 +1,319 @@
+#include "column_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+// sse2 is part of every x86-64 cpu, the portable loops are not vectorised by every compiler at -O2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLUMN_STATS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace tool
+{
+    namespace
+    {
+        const int lanes = 8;// independent accumulators, each step is one vector operation per lane group
+        const size_t block = 1024;// values converted to double at a time
+
+        // running sums of a column, NaN is left out: it fails x == x, and x < lo is false for it
+        typedef struct Accumulator {
+            double sum[lanes];
+            double count[lanes];
+            double lo[lanes];
+            double hi[lanes];
+        }Accumulator;
+
+        // values after the last full step of lanes, into the first lane
+        void add_tail(const double* x, size_t i, size_t size, Accumulator& acc)
+        {
+            for (; i < size; i++)
+            {
+                double v = x[i];
+                bool valid = (v == v);
+                acc.sum[0] += valid ? v : 0.0;
+                acc.count[0] += valid ? 1.0 : 0.0;
+                acc.lo[0] = (v < acc.lo[0]) ? v : acc.lo[0];
+                acc.hi[0] = (v > acc.hi[0]) ? v : acc.hi[0];
+            }
+        }
+
+        void add_squares_tail(const double* x, size_t i, size_t size, double mean, double* square)
+        {
+            for (; i < size; i++)
+            {
+                double d = x[i] - mean;
+                square[0] += (d == d) ? d * d : 0.0;
+            }
+        }
+
+#if defined(COLUMN_STATS_SSE2)
+        const int vectors = lanes / 2;
+
+        // two lanes per register. min_pd(v, lo) is lo when v is NaN, cmpord_pd masks NaN out of the sums
+        void add_block(const double* x, size_t size, Accumulator& acc)
+        {
+            __m128d sum[vectors], count[vectors], lo[vectors], hi[vectors];
+            for (int j = 0; j < vectors; j++)
+            {
+                sum[j] = _mm_loadu_pd(acc.sum + 2 * j);
+                count[j] = _mm_loadu_pd(acc.count + 2 * j);
+                lo[j] = _mm_loadu_pd(acc.lo + 2 * j);
+                hi[j] = _mm_loadu_pd(acc.hi + 2 * j);
+            }
+            const __m128d one = _mm_set1_pd(1.0);
+            size_t i = 0;
+            for (; i + lanes <= size; i += lanes)
+            {
+                for (int j = 0; j < vectors; j++)
+                {
+                    __m128d v = _mm_loadu_pd(x + i + 2 * j);
+                    __m128d valid = _mm_cmpord_pd(v, v);
+                    sum[j] = _mm_add_pd(sum[j], _mm_and_pd(valid, v));
+                    count[j] = _mm_add_pd(count[j], _mm_and_pd(valid, one));
+                    lo[j] = _mm_min_pd(v, lo[j]);
+                    hi[j] = _mm_max_pd(v, hi[j]);
+                }
+            }
+            for (int j = 0; j < vectors; j++)
+            {
+                _mm_storeu_pd(acc.sum + 2 * j, sum[j]);
+                _mm_storeu_pd(acc.count + 2 * j, count[j]);
+                _mm_storeu_pd(acc.lo + 2 * j, lo[j]);
+                _mm_storeu_pd(acc.hi + 2 * j, hi[j]);
+            }
+            add_tail(x, i, size, acc);
+        }
+
+        void add_squares(const double* x, size_t size, double mean, double* square)
+        {
+            __m128d s[vectors];
+            for (int j = 0; j < vectors; j++)
+                s[j] = _mm_loadu_pd(square + 2 * j);
+            const __m128d m = _mm_set1_pd(mean);
+            size_t i = 0;
+            for (; i + lanes <= size; i += lanes)
+            {
+                for (int j = 0; j < vectors; j++)
+                {
+                    __m128d d = _mm_sub_pd(_mm_loadu_pd(x + i + 2 * j), m);
+                    s[j] = _mm_add_pd(s[j], _mm_and_pd(_mm_cmpord_pd(d, d), _mm_mul_pd(d, d)));
+                }
+            }
+            for (int j = 0; j < vectors; j++)
+                _mm_storeu_pd(square + 2 * j, s[j]);
+            add_squares_tail(x, i, size, mean, square);
+        }
+#else
+        // the lanes are copied in and out, x may alias them and they would not stay in registers
+        void add_block(const double* x, size_t size, Accumulator& acc)
+        {
+            Accumulator a = acc;
+            size_t i = 0;
+            for (; i + lanes <= size; i += lanes)
+            {
+                for (int k = 0; k < lanes; k++)
+                {
+                    double v = x[i + k];
+                    bool valid = (v == v);
+                    a.sum[k] += valid ? v : 0.0;
+                    a.count[k] += valid ? 1.0 : 0.0;
+                    a.lo[k] = (v < a.lo[k]) ? v : a.lo[k];
+                    a.hi[k] = (v > a.hi[k]) ? v : a.hi[k];
+                }
+            }
+            add_tail(x, i, size, a);
+            acc = a;
+        }
+
+        void add_squares(const double* x, size_t size, double mean, double* square)
+        {
+            double s[lanes];
+            std::copy(square, square + lanes, s);
+            size_t i = 0;
+            for (; i + lanes <= size; i += lanes)
+            {
+                for (int k = 0; k < lanes; k++)
+                {
+                    double d = x[i + k] - mean;
+                    s[k] += (d == d) ? d * d : 0.0;
+                }
+            }
+            add_squares_tail(x, i, size, mean, s);
+            std::copy(s, s + lanes, square);
+        }
+#endif
+
+        void add_histogram(const double* x, size_t size, double lo, double scale, std::vector<unsigned>& histogram)
+        {
+            int top = (int)histogram.size() - 1;
+            for (size_t i = 0; i < size; i++)
+            {
+                double v = x[i];
+                if (!std::isfinite(v))
+                    continue;
+                int b = (int)((v - lo) * scale);
+                histogram[std::min(std::max(b, 0), top)]++;
+            }
+        }
+
+        // the values of v, block by block converted into buffer (gathered through the rows for a RowView)
+        template <typename Container, typename F>
+        void for_blocks(const Container& v, double* buffer, F f)
+        {
+            const size_t size = v.size();
+            for (size_t first = 0; first < size; first += block)
+            {
+                size_t count = std::min(block, size - first);
+                for (size_t i = 0; i < count; i++)
+                    buffer[i] = (double)v[first + i];
+                f(buffer, count);
+            }
+        }
+
+        template <typename Container>
+        void reduce(const Container& v, int bins, ColumnStats& stats)
+        {
+            stats.numeric = true;
+            double buffer[block];
+            Accumulator acc;
+            std::fill(acc.sum, acc.sum + lanes, 0.0);
+            std::fill(acc.count, acc.count + lanes, 0.0);
+            std::fill(acc.lo, acc.lo + lanes, std::numeric_limits<double>::infinity());
+            std::fill(acc.hi, acc.hi + lanes, -std::numeric_limits<double>::infinity());
+            for_blocks(v, buffer, [&acc](const double* x, size_t size) { add_block(x, size, acc); });
+
+            double count = 0.0;
+            for (int k = 0; k < lanes; k++)
+            {
+                stats.sum += acc.sum[k];
+                count += acc.count[k];
+                acc.lo[0] = std::min(acc.lo[0], acc.lo[k]);
+                acc.hi[0] = std::max(acc.hi[0], acc.hi[k]);
+            }
+            stats.count = (size_t)count;
+            if (!stats.count)
+            {
+                stats.sum = 0.0;
+                return;
+            }
+            stats.min = acc.lo[0];
+            stats.max = acc.hi[0];
+            stats.mean = stats.sum / stats.count;
+
+            // second pass around the mean, no cancellation of large sums of squares
+            double square[lanes] = {};
+            const double mean = stats.mean;
+            for_blocks(v, buffer, [mean, &square](const double* x, size_t size) { add_squares(x, size, mean, square); });
+            for (int k = 1; k < lanes; k++)
+                square[0] += square[k];
+            stats.stddev = std::sqrt(square[0] / stats.count);
+
+            if (bins <= 0)
+                return;
+            double range = stats.max - stats.min;
+            if (!std::isfinite(range))
+                return;// an infinite value, or a span beyond double: no bins to spread over
+            stats.histogram.assign(bins, 0);
+            double scale = (range > 0.0) ? bins / range : 0.0;
+            const double lo = stats.min;
+            for_blocks(v, buffer, [lo, scale, &stats](const double* x, size_t size) { add_histogram(x, size, lo, scale, stats.histogram); });
+        }
+    }
+
+    void compute_column_stats(const Column& column, const RowSet* rows, int bins, ColumnStats& stats)
+    {
+        stats = ColumnStats();
+        std::visit([&](const auto& values) {
+            using V = typename std::decay<decltype(values)>::type::value_type;
+            if constexpr (std::is_same<V, std::string>::value)
+            {
+                stats.count = rows ? rows->size() : values.size();
+            }
+            else if (rows)
+            {
+                reduce(RowView<V>(values, *rows), bins, stats);
+            }
+            else
+            {
+                reduce(values, bins, stats);
+            }
+        }, column.storage());
+    }
+
+    ColumnStatsWorker::ColumnStatsWorker(const WorkerPool::GroupPtr& group, Done done)
+        : group_(group)
+        , state_(std::make_shared<State>())
+    {
+        this->state_->done = std::move(done);
+    }
+
+    ColumnStatsWorker::~ColumnStatsWorker()
+    {
+        std::unique_lock<std::mutex> lock(this->state_->lock);
+        this->state_->stop = true;
+        this->state_->data.reset();
+        this->state_->rows.reset();
+        this->state_->idle.wait(lock, [this]() { return !this->state_->running; });
+    }
+
+    void ColumnStatsWorker::request(const ColumnTablePtr& data, const RowSetPtr& rows, int bins)
+    {
+        if (!data)
+            return;
+        std::shared_ptr<State> state = this->state_;
+        {
+            std::lock_guard<std::mutex> lock(state->lock);
+            state->data = data;
+            state->rows = rows;
+            state->bins = bins;
+            state->pending = true;
+            if (state->scheduled)
+                return;// the queued or running task takes it
+            state->scheduled = true;
+        }
+        this->group_->submit([state]() { run(state); });
+    }
+
+    void ColumnStatsWorker::run(const std::shared_ptr<State>& state)
+    {
+        while (true)
+        {
+            ColumnTablePtr data;
+            RowSetPtr rows;
+            int bins = 0;
+            {
+                std::lock_guard<std::mutex> lock(state->lock);
+                if (state->stop || !state->pending)
+                {
+                    state->scheduled = false;
+                    return;
+                }
+                data.swap(state->data);
+                rows.swap(state->rows);
+                bins = state->bins;
+                state->pending = false;
+                state->running = true;
+            }
+
+            // the columns are independent, they are spread over the pool
+            std::shared_ptr<TableStats> stats = std::make_shared<TableStats>();
+            stats->sequence = data->sequence();
+            stats->rows = rows ? rows->size() : data->size();
+            stats->columns.resize(data->columnCount());
+            WorkerPool::shared().parallel((unsigned)data->columnCount(), [&](unsigned c) {
+                compute_column_stats(data->column(c), rows.get(), bins, stats->columns[c]);
+            });
+            data.reset();// the snapshot is not held longer than needed
+
+            if (state->done)
+                state->done(stats);
+            {
+                std::lock_guard<std::mutex> lock(state->lock);
+                state->running = false;
+            }
+            state->idle.notify_all();
+        }
+    }
+}
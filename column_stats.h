@@ -0,0 +1,78 @@
+#ifndef COLUMN_STATS_H
+#define COLUMN_STATS_H
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "column_table.h"
+#include "worker_pool.h"
+
+namespace tool
+{
+    // summary of one column, NaN values are not counted. string columns only get count
+    typedef struct ColumnStats {
+        size_t count = 0;
+        bool numeric = false;// min to histogram are set
+        double min = 0.0;
+        double max = 0.0;
+        double sum = 0.0;
+        double mean = 0.0;
+        double stddev = 0.0;// population standard deviation
+        std::vector<unsigned> histogram;// equal bins over [min, max], empty if max - min is not finite
+    }ColumnStats;
+
+    typedef struct TableStats {
+        unsigned long long sequence = 0;// of the snapshot
+        size_t rows = 0;
+        std::vector<ColumnStats> columns;
+    }TableStats;
+
+    using TableStatsPtr = std::shared_ptr<const TableStats>;
+
+    // stats of the listed rows of column (all if rows is null), bins histogram bins (0 for none)
+    void compute_column_stats(const Column& column, const RowSet* rows, int bins, ColumnStats& stats);
+
+    // computes the stats of the requested snapshots as tasks of group, one at a time, a request replaces
+    // the one not started yet. nothing is computed while the group is paused.
+    // every request sums up all its rows again: min and max cannot be taken back when the extreme row
+    // changes, the bins move with them, and the filtered rows differ from frame to frame. the cost is
+    // bounded by the pool, not the frame rate: frames arriving during a run are skipped but the last one
+    class ColumnStatsWorker
+    {
+    public:
+        // called on a pool thread with every result
+        using Done = std::function<void(const TableStatsPtr& stats)>;
+
+        ColumnStatsWorker(const WorkerPool::GroupPtr& group, Done done);
+        ~ColumnStatsWorker();// waits for the running computation, a queued task does nothing
+
+        ColumnStatsWorker(const ColumnStatsWorker&) = delete;
+        ColumnStatsWorker& operator=(const ColumnStatsWorker&) = delete;
+
+        void request(const ColumnTablePtr& data, const RowSetPtr& rows, int bins);
+
+    private:
+        // shared with the queued task, it may run after the worker is gone
+        typedef struct State {
+            Done done;
+            std::mutex lock;
+            std::condition_variable idle;// the destructor: running got false
+            bool stop = false;
+            bool scheduled = false;// a task is queued or running
+            bool running = false;
+            bool pending = false;
+            ColumnTablePtr data;
+            RowSetPtr rows;
+            int bins = 0;
+        }State;
+
+        static void run(const std::shared_ptr<State>& state);
+
+        WorkerPool::GroupPtr group_;
+        std::shared_ptr<State> state_;
+    };
+}
+
+#endif // COLUMN_STATS_H
@@ -0,0 +1,212 @@
+#include "column_table.h"
+#include <algorithm>
+#include <type_traits>
+
+namespace tool
+{
+    bool operator==(const ColumnSpec& l, const ColumnSpec& r)
+    {
+        return (l.type == r.type) && (l.name == r.name);
+    }
+
+    bool operator!=(const ColumnSpec& l, const ColumnSpec& r)
+    {
+        return !(l == r);
+    }
+
+    namespace
+    {
+        Column::Storage make_storage(ColumnType type)
+        {
+            switch (type)
+            {
+            case ColumnType::Int64:
+                return std::vector<int64_t>();
+            case ColumnType::Float:
+                return std::vector<float>();
+            case ColumnType::Double:
+                return std::vector<double>();
+            case ColumnType::String:
+                return std::vector<std::string>();
+            case ColumnType::Int32:
+            default:
+                break;
+            }
+            return std::vector<int32_t>();
+        }
+    }
+
+    Column::Column(ColumnType type)
+        : type_(type)
+        , storage_(make_storage(type))
+    {
+    }
+
+    size_t Column::size() const
+    {
+        return std::visit([](const auto& v) { return v.size(); }, this->storage_);
+    }
+
+    size_t Column::capacity() const
+    {
+        return std::visit([](const auto& v) { return v.capacity(); }, this->storage_);
+    }
+
+    void Column::resize(size_t size)
+    {
+        std::visit([size](auto& v) { v.resize(size); }, this->storage_);
+    }
+
+    double Column::number(size_t row) const
+    {
+        switch (this->type_)
+        {
+        case ColumnType::Int32:
+            return std::get<std::vector<int32_t> >(this->storage_)[row];
+        case ColumnType::Int64:
+            return (double)std::get<std::vector<int64_t> >(this->storage_)[row];
+        case ColumnType::Float:
+            return std::get<std::vector<float> >(this->storage_)[row];
+        case ColumnType::Double:
+            return std::get<std::vector<double> >(this->storage_)[row];
+        default:
+            break;
+        }
+        return 0.0;
+    }
+
+    ColumnTable::ColumnTable()
+    {
+    }
+
+    ColumnTable::ColumnTable(const Schema& schema, size_t rows)
+    {
+        setSchema(schema);
+        resize(rows);
+    }
+
+    void ColumnTable::setSchema(const Schema& schema)
+    {
+        if (schema == this->schema_)
+            return;
+
+        std::vector<Column> columns;
+        columns.reserve(schema.size());
+        for (size_t c = 0; c < schema.size(); c++)
+        {
+            if ((c < this->columns_.size()) && (this->columns_[c].type() == schema[c].type))
+                columns.push_back(std::move(this->columns_[c]));// keep the buffer
+            else
+                columns.push_back(Column(schema[c].type));
+            columns.back().resize(this->rows_);
+        }
+        this->columns_.swap(columns);
+        this->schema_ = schema;
+    }
+
+    size_t ColumnTable::capacity() const
+    {
+        if (this->columns_.empty())
+            return 0;
+
+        size_t cap = this->columns_[0].capacity();
+        for (auto& col : this->columns_)
+            cap = std::min(cap, col.capacity());
+        return cap;
+    }
+
+    void ColumnTable::resize(size_t rows)
+    {
+        for (auto& col : this->columns_)
+            col.resize(rows);
+        this->rows_ = rows;
+    }
+
+    int ColumnTable::columnIndex(const std::string& name) const
+    {
+        for (size_t c = 0; c < this->schema_.size(); c++)
+        {
+            if (this->schema_[c].name == name)
+                return (int)c;
+        }
+        return -1;
+    }
+
+    const Schema& ColumnTable::legacySchema()
+    {
+        static const Schema schema = {
+            { "idx", ColumnType::Int32 },
+            { "v1", ColumnType::Int32 },
+            { "v2", ColumnType::Int32 },
+            { "v3", ColumnType::Float },
+        };
+        return schema;
+    }
+
+    void ColumnTable::assign(const Datas& rows)
+    {
+        setSchema(legacySchema());
+        resize(rows.size());
+
+        // one pass over the rows, four streaming writes
+        int32_t* idx = this->columns_[0].values<int32_t>().data();
+        int32_t* v1 = this->columns_[1].values<int32_t>().data();
+        int32_t* v2 = this->columns_[2].values<int32_t>().data();
+        float* v3 = this->columns_[3].values<float>().data();
+        size_t size = rows.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            const DataStruct& it = rows[i];
+            idx[i] = it.idx;
+            v1[i] = it.v1;
+            v2[i] = it.v2;
+            v3[i] = it.v3;
+        }
+    }
+
+    void ColumnTable::copyRows(const ColumnTable& src, const std::vector<size_t>& rows)
+    {
+        if (src.schema() != this->schema_ || src.size() != this->rows_)
+            return;
+
+        for (size_t c = 0; c < this->columns_.size(); c++)
+        {
+            std::visit([this, &rows](auto& dst, const auto& from) {
+                using D = std::decay_t<decltype(dst)>;
+                using S = std::decay_t<decltype(from)>;
+                if constexpr (std::is_same<D, S>::value)
+                {
+                    for (auto r : rows)
+                    {
+                        if (r < this->rows_)
+                            dst[r] = from[r];
+                    }
+                }
+            }, this->columns_[c].storage(), src.column(c).storage());
+        }
+    }
+
+    size_t ColumnTable::patch(const RowPatch* rows, size_t count)
+    {
+        if (this->schema_ != legacySchema())
+            return 0;
+
+        int32_t* idx = this->columns_[0].values<int32_t>().data();
+        int32_t* v1 = this->columns_[1].values<int32_t>().data();
+        int32_t* v2 = this->columns_[2].values<int32_t>().data();
+        float* v3 = this->columns_[3].values<float>().data();
+        size_t written = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            const RowPatch& it = rows[i];
+            if (it.row < 0 || (size_t)it.row >= this->rows_)
+                continue;
+            idx[it.row] = it.data.idx;
+            v1[it.row] = it.data.v1;
+            v2[it.row] = it.data.v2;
+            v3[it.row] = it.data.v3;
+            written++;
+        }
+        return written;
+    }
+}
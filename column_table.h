@@ -0,0 +1,164 @@
+#ifndef COLUMN_TABLE_H
+#define COLUMN_TABLE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace tool
+{
+    // row of the legacy four column layout, producers may still fill these and call Update
+    typedef struct DataStruct {
+        int idx = 0;
+        int v1 = 0;
+        int v2 = 0;
+        float v3 = 0.0;
+    }DataStruct;
+
+    using Datas = std::vector<DataStruct>;
+    using DatasPtr = std::shared_ptr<Datas>;
+
+    // new content of one row, row is the position in the snapshot
+    typedef struct RowPatch {
+        int row = 0;
+        DataStruct data;
+    }RowPatch;
+
+    typedef struct RowPatchBatch {
+        unsigned long long sequence = 0;
+        std::vector<RowPatch> rows;
+    }RowPatchBatch;
+
+    enum class ColumnType
+    {
+        Int32,
+        Int64,
+        Float,
+        Double,
+        String,
+    };
+
+    typedef struct ColumnSpec {
+        std::string name;
+        ColumnType type = ColumnType::Int32;
+    }ColumnSpec;
+
+    using Schema = std::vector<ColumnSpec>;
+
+    bool operator==(const ColumnSpec& l, const ColumnSpec& r);
+    bool operator!=(const ColumnSpec& l, const ColumnSpec& r);
+
+    // one contiguous typed array
+    class Column
+    {
+    public:
+        using Storage = std::variant<std::vector<int32_t>, std::vector<int64_t>,
+            std::vector<float>, std::vector<double>, std::vector<std::string> >;
+
+        Column(ColumnType type = ColumnType::Int32);
+
+        ColumnType type() const { return type_; }
+        size_t size() const;
+        size_t capacity() const;
+        void resize(size_t size);
+
+        template <typename T>
+        std::vector<T>& values() { return std::get<std::vector<T> >(storage_); }
+        template <typename T>
+        const std::vector<T>& values() const { return std::get<std::vector<T> >(storage_); }
+
+        // the typed array, use std::visit to work on it without a switch
+        Storage& storage() { return storage_; }
+        const Storage& storage() const { return storage_; }
+
+        // value as double, 0 for string columns
+        double number(size_t row) const;
+
+    private:
+        ColumnType type_;
+        Storage storage_;
+    };
+
+    // table stored column by column, the columns are declared by a schema at runtime
+    class ColumnTable
+    {
+    public:
+        ColumnTable();
+        ColumnTable(const Schema& schema, size_t rows = 0);
+
+        const Schema& schema() const { return schema_; }
+
+        // columns keeping their type keep their buffers
+        void setSchema(const Schema& schema);
+
+        size_t columnCount() const { return columns_.size(); }
+        size_t rowCount() const { return rows_; }
+        size_t size() const { return rows_; }
+        size_t capacity() const;
+        void resize(size_t rows);
+
+        Column& column(size_t c) { return columns_[c]; }
+        const Column& column(size_t c) const { return columns_[c]; }
+
+        // index of the column called name, -1 if there is none
+        int columnIndex(const std::string& name) const;
+
+        // idx, v1, v2 (int32) and v3 (float), the columns of DataStruct
+        static const Schema& legacySchema();
+
+        // fill from legacy rows, the schema becomes legacySchema
+        void assign(const Datas& rows);
+
+        // write the listed rows of src into the same rows, src has the schema and size of this table.
+        // rows out of range are skipped
+        void copyRows(const ColumnTable& src, const std::vector<size_t>& rows);
+
+        // write legacy rows in place, the schema must be legacySchema.
+        // rows out of range are skipped, return the number written
+        size_t patch(const RowPatch* rows, size_t count);
+
+        // order of publishing, set by SpreadSheet::Update
+        unsigned long long sequence() const { return sequence_; }
+        void setSequence(unsigned long long sequence) { sequence_ = sequence; }
+
+    private:
+        Schema schema_;
+        std::vector<Column> columns_;
+        size_t rows_ = 0;
+        unsigned long long sequence_ = 0;
+    };
+
+    using ColumnTablePtr = std::shared_ptr<ColumnTable>;
+
+    // positions of rows in a table, not changed once shared
+    using RowSet = std::vector<int>;
+    using RowSetPtr = std::shared_ptr<const RowSet>;
+
+    // the values of the listed rows of a column array, read through the list without copying.
+    // the rows must be in range
+    template <typename T>
+    class RowView
+    {
+    public:
+        using value_type = T;
+
+        RowView(const std::vector<T>& values, const RowSet& rows)
+            : values_(values.data())
+            , rows_(rows.data())
+            , size_(rows.size())
+        {
+        }
+
+        const T& operator[](size_t i) const { return this->values_[this->rows_[i]]; }
+        size_t size() const { return this->size_; }
+
+    private:
+        const T* values_;
+        const int* rows_;
+        size_t size_;
+    };
+}
+
+#endif // COLUMN_TABLE_H
@@ -0,0 +1,210 @@
+#include "copy_job.h"
+#include <algorithm>
+#include "radix_sort.h"
+#include "row_format.h"
+
+namespace tool
+{
+    namespace
+    {
+        // rows formatted by one thread into one block
+        const size_t copy_block_rows = 1 << 14;
+
+        // sorted distinct values of the intervals [first, last]
+        std::vector<int> merge_spans(std::vector<std::pair<int, int> >& spans)
+        {
+            std::sort(spans.begin(), spans.end());
+            std::vector<int> values;
+            int next = 0;// first value not taken yet
+            for (auto& it : spans)
+            {
+                int first = std::max(it.first, next);
+                for (int v = first; v <= it.second; v++)
+                    values.push_back(v);
+                next = std::max(next, it.second + 1);
+            }
+            return values;
+        }
+    }
+
+    size_t count_cells(const std::vector<CellRange>& ranges)
+    {
+        size_t cells = 0;
+        for (auto& it : ranges)
+        {
+            if (it.bottom >= it.top && it.right >= it.left)
+                cells += (size_t)(it.bottom - it.top + 1) * (size_t)(it.right - it.left + 1);
+        }
+        return cells;
+    }
+
+    bool format_selection(const ColumnTable& data, const RowSet* rows, const std::vector<size_t>& index,
+        const std::vector<CellRange>& ranges, std::string& out, const std::atomic<bool>* cancel)
+    {
+        out.clear();
+        int view_rows = (int)index.size();
+        int view_columns = (int)data.columnCount();
+
+        // ranges clipped to the view, one rectangle with the same columns as the others needs no mask
+        std::vector<CellRange> clipped;
+        std::vector<std::pair<int, int> > row_spans;
+        std::vector<std::pair<int, int> > column_spans;
+        bool uniform = true;
+        for (auto& it : ranges)
+        {
+            CellRange r = it;
+            r.top = std::max(r.top, 0);
+            r.bottom = std::min(r.bottom, view_rows - 1);
+            r.left = std::max(r.left, 0);
+            r.right = std::min(r.right, view_columns - 1);
+            if (r.top > r.bottom || r.left > r.right)
+                continue;
+            if (!clipped.empty() && (r.left != clipped[0].left || r.right != clipped[0].right))
+                uniform = false;
+            clipped.push_back(r);
+            row_spans.push_back({ r.top, r.bottom });
+            column_spans.push_back({ r.left, r.right });
+        }
+        if (clipped.empty())
+            return true;
+        std::vector<int> view_row = merge_spans(row_spans);
+        std::vector<int> columns = merge_spans(column_spans);
+
+        // otherwise one byte per cell of the view_row x columns grid
+        std::vector<unsigned char> mask;
+        if (!uniform)
+        {
+            std::vector<int> row_pos(view_rows, -1);
+            for (size_t i = 0; i < view_row.size(); i++)
+                row_pos[view_row[i]] = (int)i;
+            std::vector<int> column_pos(view_columns, -1);
+            for (size_t j = 0; j < columns.size(); j++)
+                column_pos[columns[j]] = (int)j;
+
+            mask.assign(view_row.size() * columns.size(), 0);
+            for (auto& r : clipped)
+            {
+                for (int vr = r.top; vr <= r.bottom; vr++)
+                {
+                    unsigned char* line = &mask[row_pos[vr] * columns.size()];
+                    for (int c = r.left; c <= r.right; c++)
+                        line[column_pos[c]] = 1;
+                }
+            }
+        }
+
+        auto format_rows = [&](std::string& block, size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+            {
+                size_t pos = index[view_row[i]];
+                if (rows)
+                    pos = (pos < rows->size()) ? (size_t)(*rows)[pos] : data.size();
+                const unsigned char* line = uniform ? nullptr : &mask[i * columns.size()];
+                for (size_t j = 0; j < columns.size(); j++)
+                {
+                    if (j)
+                        block.push_back('\t');
+                    if ((pos < data.size()) && (!line || line[j]))
+                        append_cell(block, data.column(columns[j]), pos);
+                }
+                block.push_back('\n');
+            }
+        };
+
+        size_t size = view_row.size();
+        if (size <= copy_block_rows)
+        {
+            out.reserve(size * columns.size() * 8);
+            format_rows(out, 0, size);
+            return true;
+        }
+
+        // every round each thread formats one block, the blocks are appended to out in order
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = (unsigned)std::min<size_t>(threads, (size + copy_block_rows - 1) / copy_block_rows);
+        std::vector<std::string> blocks(threads);
+        size_t round_rows = copy_block_rows * threads;
+        for (size_t begin = 0; begin < size; begin += round_rows)
+        {
+            if (cancel && *cancel)
+                return false;
+
+            parallel_for(threads, [&](unsigned t) {
+                std::string& block = blocks[t];
+                block.clear();
+                size_t first = std::min(size, begin + t * copy_block_rows);
+                size_t last = std::min(size, first + copy_block_rows);
+                block.reserve((last - first) * columns.size() * 8);
+                format_rows(block, first, last);
+            });
+
+            // the first round tells how long the text gets, the buffer is allocated once
+            if (!begin)
+            {
+                size_t bytes = 0;
+                for (auto& block : blocks)
+                    bytes += block.size();
+                out.reserve(bytes * (size + round_rows - 1) / round_rows + bytes / 8);
+            }
+            for (auto& block : blocks)
+                out.append(block);
+        }
+        return true;
+    }
+
+    CopyJob::CopyJob(const ColumnTablePtr& data, const RowSetPtr& rows, std::vector<size_t> index, std::vector<CellRange> ranges)
+        : data_(data)
+        , rows_(rows)
+        , index_(std::move(index))
+        , ranges_(std::move(ranges))
+        , cancel_(false)
+        , running_(false)
+    {
+    }
+
+    CopyJob::~CopyJob()
+    {
+        cancel();
+        wait();
+    }
+
+    void CopyJob::start(Order order, Finished finished)
+    {
+        if (this->thread_.joinable())
+            return;
+
+        this->cancel_ = false;
+        this->running_ = true;
+        this->thread_ = std::thread(&CopyJob::run, this, std::move(order), std::move(finished));
+    }
+
+    void CopyJob::cancel()
+    {
+        this->cancel_ = true;
+    }
+
+    void CopyJob::wait()
+    {
+        if (this->thread_.joinable())
+            this->thread_.join();
+    }
+
+    void CopyJob::run(Order order, Finished finished)
+    {
+        std::string text;
+        bool ok = false;
+        if (this->data_)
+        {
+            if (order)
+            {
+                this->index_.resize(this->rows_ ? this->rows_->size() : this->data_->size());
+                order(*this->data_, this->rows_.get(), this->index_);
+            }
+            ok = format_selection(*this->data_, this->rows_.get(), this->index_, this->ranges_, text, &this->cancel_);
+        }
+
+        if (ok && !this->cancel_ && finished)
+            finished(text);
+        this->running_ = false;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef COPY_JOB_H
+#define COPY_JOB_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "column_table.h"
+
+namespace tool
+{
+    // selected view rows [top, bottom] and columns [left, right]
+    typedef struct CellRange {
+        int top = 0;
+        int bottom = -1;
+        int left = 0;
+        int right = -1;
+    }CellRange;
+
+    // number of cells of ranges, overlaps counted twice
+    size_t count_cells(const std::vector<CellRange>& ranges);
+
+    // UTF-8 text of the selected cells, view row r is data row index[r] (rows ? (*rows)[index[r]] : index[r]).
+    // the rows and columns of any range are written in view order, cells tab separated, every row ends with
+    // a newline; cells of those rows and columns out of every range are left empty.
+    // rows are formatted in blocks by several threads, false if cancel was set (out is incomplete then)
+    bool format_selection(const ColumnTable& data, const RowSet* rows, const std::vector<size_t>& index,
+        const std::vector<CellRange>& ranges, std::string& out, const std::atomic<bool>* cancel = nullptr);
+
+    // formats a selection of one snapshot on a worker thread, for selections too large to copy in the GUI thread.
+    // the job holds the snapshot and its own copy of the permutation
+    class CopyJob
+    {
+    public:
+        // fill index with the row order, run on the worker thread first. with rows index holds positions in rows
+        using Order = std::function<void(const ColumnTable& data, const RowSet* rows, std::vector<size_t>& index)>;
+        // called once on the worker thread, not on cancel. text may be moved from
+        using Finished = std::function<void(std::string& text)>;
+
+        CopyJob(const ColumnTablePtr& data, const RowSetPtr& rows, std::vector<size_t> index, std::vector<CellRange> ranges);
+        ~CopyJob();// cancel and wait
+
+        CopyJob(const CopyJob&) = delete;
+        CopyJob& operator=(const CopyJob&) = delete;
+
+        // order null keeps the index given to the constructor
+        void start(Order order, Finished finished);
+
+        void cancel();
+        bool running() const { return running_.load(); }
+        void wait();
+
+    private:
+        void run(Order order, Finished finished);
+
+        ColumnTablePtr data_;
+        RowSetPtr rows_;
+        std::vector<size_t> index_;
+        std::vector<CellRange> ranges_;
+        std::thread thread_;
+        std::atomic<bool> cancel_;
+        std::atomic<bool> running_;
+    };
+}
+
+#endif // COPY_JOB_H
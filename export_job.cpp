@@ -0,0 +1,125 @@
+#include "export_job.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <numeric>
+#include "radix_sort.h"
+#include "row_format.h"
+
+namespace tool
+{
+    namespace
+    {
+        // rows formatted by one thread into one block, one write per block
+        const size_t export_block_rows = 1 << 14;
+    }
+
+    ExportJob::ExportJob(const ColumnTablePtr& data, const std::string& path, const RowSetPtr& rows)
+        : data_(data)
+        , rows_(rows)
+        , path_(path)
+        , cancel_(false)
+        , running_(false)
+    {
+    }
+
+    ExportJob::~ExportJob()
+    {
+        cancel();
+        wait();
+    }
+
+    void ExportJob::start(Order order, Progress progress, Finished finished)
+    {
+        if (this->thread_.joinable())
+            return;
+
+        this->cancel_ = false;
+        this->running_ = true;
+        this->thread_ = std::thread(&ExportJob::run, this, std::move(order), std::move(progress), std::move(finished));
+    }
+
+    void ExportJob::cancel()
+    {
+        this->cancel_ = true;
+    }
+
+    void ExportJob::wait()
+    {
+        if (this->thread_.joinable())
+            this->thread_.join();
+    }
+
+    void ExportJob::run(Order order, Progress progress, Finished finished)
+    {
+        bool ok = false;
+        std::string message;
+        do
+        {
+            if (!this->data_)
+            {
+                message = "No data.";
+                break;
+            }
+
+            std::ofstream out(this->path_, std::ios::binary);
+            if (!out.is_open())
+            {
+                message = "Open file error.";
+                break;
+            }
+
+            const ColumnTable& data = *this->data_;
+            const RowSet* rows = this->rows_.get();
+            size_t size = rows ? rows->size() : data.size();
+            std::vector<size_t> index(size);
+            if (order)
+                order(data, rows, index);
+            else
+                std::iota(index.begin(), index.end(), 0);
+
+            // every round each thread formats one block, the blocks are written in order
+            unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+            threads = (unsigned)std::max<size_t>(1, std::min<size_t>(threads, (size + export_block_rows - 1) / export_block_rows));
+            std::vector<std::string> blocks(threads);
+            size_t round_rows = export_block_rows * threads;
+            for (size_t begin = 0; begin < size && !this->cancel_; begin += round_rows)
+            {
+                parallel_for(threads, [&](unsigned t) {
+                    std::string& block = blocks[t];
+                    block.clear();
+                    size_t first = std::min(size, begin + t * export_block_rows);
+                    size_t last = std::min(size, first + export_block_rows);
+                    for (size_t r = first; r < last; r++)
+                        append_row(block, data, rows ? (*rows)[index[r]] : index[r]);
+                });
+
+                for (auto& block : blocks)
+                    out.write(block.data(), block.size());
+                if (!out)
+                    break;
+                if (progress)
+                    progress(std::min(size, begin + round_rows), size);
+            }
+
+            // a cancelled or failed export leaves no partial file behind
+            out.close();
+            if (this->cancel_)
+            {
+                std::remove(this->path_.c_str());
+                break;
+            }
+            if (!out)
+            {
+                std::remove(this->path_.c_str());
+                message = "Write file error.";
+                break;
+            }
+            ok = true;
+        } while (false);
+
+        if (finished)
+            finished(ok, message);
+        this->running_ = false;
+    }
+}
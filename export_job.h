@@ -0,0 +1,55 @@
+#ifndef EXPORT_JOB_H
+#define EXPORT_JOB_H
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "column_table.h"
+
+namespace tool
+{
+    // writes the rows of one snapshot to a text file on a worker thread.
+    // the job holds the snapshot, frames arriving meanwhile go to other tables
+    class ExportJob
+    {
+    public:
+        // fill index with the row order, run on the worker thread before writing.
+        // with rows index holds positions in rows
+        using Order = std::function<void(const ColumnTable& data, const RowSet* rows, std::vector<size_t>& index)>;
+        // rows written so far, called on the worker thread
+        using Progress = std::function<void(size_t done, size_t total)>;
+        // called once on the worker thread at the end, message is empty on success and on cancel.
+        // the file of a failed write is removed like that of a cancel
+        using Finished = std::function<void(bool ok, const std::string& message)>;
+
+        // only the listed rows of data if rows is set, they must be in range
+        ExportJob(const ColumnTablePtr& data, const std::string& path, const RowSetPtr& rows = RowSetPtr());
+        ~ExportJob();// cancel and wait
+
+        ExportJob(const ExportJob&) = delete;
+        ExportJob& operator=(const ExportJob&) = delete;
+
+        void start(Order order, Progress progress, Finished finished);
+
+        // stop at the next block, the partial file is removed
+        void cancel();
+        bool cancelled() const { return cancel_.load(); }
+
+        bool running() const { return running_.load(); }
+        void wait();
+
+    private:
+        void run(Order order, Progress progress, Finished finished);
+
+        ColumnTablePtr data_;
+        RowSetPtr rows_;
+        std::string path_;
+        std::thread thread_;
+        std::atomic<bool> cancel_;
+        std::atomic<bool> running_;
+    };
+}
+
+#endif // EXPORT_JOB_H
@@ -0,0 +1,623 @@
+#include "frame_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <type_traits>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tool
+{
+    namespace
+    {
+        const size_t max_queued_frames = 64;
+
+        static_assert(std::is_trivially_copyable<RowPatch>::value, "patches are written as they are in memory");
+        static_assert(sizeof(FrameLogHeader) % 8 == 0 && sizeof(FrameRecord) % 8 == 0, "records are 8 byte aligned");
+
+        size_t pad8(size_t bytes)
+        {
+            return (bytes + 7) & ~(size_t)7;
+        }
+
+        uint64_t now_ns()
+        {
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void write_padded(std::ofstream& out, const void* data, size_t bytes)
+        {
+            static const char zeros[8] = {};
+            if (bytes)
+                out.write((const char*)data, bytes);
+            out.write(zeros, pad8(bytes) - bytes);
+        }
+
+        size_t schema_bytes(const Schema& schema)
+        {
+            size_t bytes = 0;
+            for (auto& it : schema)
+                bytes += 8 + pad8(it.name.size());
+            return bytes;
+        }
+
+        void write_schema(std::ofstream& out, const Schema& schema)
+        {
+            for (auto& it : schema)
+            {
+                uint32_t spec[2] = { (uint32_t)it.type, (uint32_t)it.name.size() };
+                out.write((const char*)spec, sizeof(spec));
+                write_padded(out, it.name.data(), it.name.size());
+            }
+        }
+
+        // bytes of the values of a column at the positions (all rows if null)
+        size_t column_bytes(const Column& column, const std::vector<int>* positions)
+        {
+            size_t count = positions ? positions->size() : column.size();
+            return std::visit([&](const auto& values) -> size_t {
+                using V = typename std::decay<decltype(values)>::type::value_type;
+                if constexpr (std::is_same<V, std::string>::value)
+                {
+                    size_t chars = 0;
+                    for (size_t k = 0; k < count; k++)
+                        chars += values[positions ? (*positions)[k] : k].size();
+                    return pad8(count * sizeof(uint32_t)) + pad8(chars);
+                }
+                else
+                {
+                    return pad8(count * sizeof(V));
+                }
+            }, column.storage());
+        }
+
+        void write_column(std::ofstream& out, const Column& column, const std::vector<int>* positions)
+        {
+            std::visit([&](const auto& values) {
+                using V = typename std::decay<decltype(values)>::type::value_type;
+                size_t count = positions ? positions->size() : values.size();
+                if constexpr (std::is_same<V, std::string>::value)
+                {
+                    std::vector<uint32_t> lengths(count);
+                    std::string chars;
+                    for (size_t k = 0; k < count; k++)
+                    {
+                        const std::string& s = values[positions ? (*positions)[k] : k];
+                        lengths[k] = (uint32_t)s.size();
+                        chars += s;
+                    }
+                    write_padded(out, lengths.data(), count * sizeof(uint32_t));
+                    write_padded(out, chars.data(), chars.size());
+                }
+                else if (!positions)
+                {
+                    write_padded(out, values.data(), count * sizeof(V));
+                }
+                else
+                {
+                    std::vector<V> gathered(count);
+                    for (size_t k = 0; k < count; k++)
+                        gathered[k] = values[(*positions)[k]];
+                    write_padded(out, gathered.data(), count * sizeof(V));
+                }
+            }, column.storage());
+        }
+
+        // rows of table differing from previous (same schema and size) in any column, bit for bit
+        void changed_rows(const ColumnTable& table, const ColumnTable& previous, std::vector<int>& changed)
+        {
+            std::vector<unsigned char> mark(table.size(), 0);
+            for (size_t c = 0; c < table.columnCount(); c++)
+            {
+                std::visit([&](const auto& values) {
+                    using Values = typename std::decay<decltype(values)>::type;
+                    using V = typename Values::value_type;
+                    const Values& before = previous.column(c).values<V>();
+                    for (size_t r = 0; r < values.size(); r++)
+                    {
+                        if constexpr (std::is_same<V, std::string>::value)
+                            mark[r] |= (values[r] != before[r]);
+                        else
+                            mark[r] |= (0 != std::memcmp(&values[r], &before[r], sizeof(V)));
+                    }
+                }, table.column(c).storage());
+            }
+
+            changed.clear();
+            for (size_t r = 0; r < mark.size(); r++)
+            {
+                if (mark[r])
+                    changed.push_back((int)r);
+            }
+        }
+
+        // reads a record payload front to back, every piece padded to 8 bytes
+        typedef struct Cursor {
+            const unsigned char* p;
+            const unsigned char* end;
+            bool ok;
+
+            const void* take(size_t bytes)
+            {
+                size_t padded = pad8(bytes);
+                if (!this->ok || (size_t)(this->end - this->p) < padded)
+                {
+                    this->ok = false;
+                    return nullptr;
+                }
+                const void* at = this->p;
+                this->p += padded;
+                return at;
+            }
+        }Cursor;
+
+        bool read_schema(Cursor& cursor, uint32_t columns, Schema& schema)
+        {
+            // two words per column at least, a corrupt count is not allocated
+            if (columns > (size_t)(cursor.end - cursor.p) / (2 * sizeof(uint32_t)))
+                return false;
+            schema.resize(columns);
+            for (auto& it : schema)
+            {
+                const uint32_t* spec = (const uint32_t*)cursor.take(2 * sizeof(uint32_t));
+                if (!spec || spec[0] > (uint32_t)ColumnType::String)
+                    return false;
+                const char* name = (const char*)cursor.take(spec[1]);
+                if (!name)
+                    return false;
+                it.type = (ColumnType)spec[0];
+                it.name.assign(name, spec[1]);
+            }
+            return true;
+        }
+
+        // the least payload of one row of schema, a string takes its length at least
+        size_t row_bytes(const Schema& schema)
+        {
+            size_t bytes = 0;
+            for (auto& it : schema)
+            {
+                switch (it.type)
+                {
+                case ColumnType::Int64:
+                case ColumnType::Double:
+                    bytes += 8;
+                    break;
+                default:
+                    bytes += 4;
+                    break;
+                }
+            }
+            return bytes;
+        }
+
+        // count values into column at positions (rows [0, count) if null), positions are in range
+        bool read_column(Cursor& cursor, Column& column, size_t count, const int32_t* positions)
+        {
+            return std::visit([&](auto& values) -> bool {
+                using V = typename std::decay<decltype(values)>::type::value_type;
+                if constexpr (std::is_same<V, std::string>::value)
+                {
+                    const uint32_t* lengths = (const uint32_t*)cursor.take(count * sizeof(uint32_t));
+                    if (!lengths)
+                        return false;
+                    size_t chars = 0;
+                    for (size_t k = 0; k < count; k++)
+                        chars += lengths[k];
+                    const char* text = (const char*)cursor.take(chars);
+                    if (!text)
+                        return false;
+                    for (size_t k = 0; k < count; k++)
+                    {
+                        values[positions ? positions[k] : k].assign(text, lengths[k]);
+                        text += lengths[k];
+                    }
+                    return true;
+                }
+                else
+                {
+                    const V* src = (const V*)cursor.take(count * sizeof(V));
+                    if (!src)
+                        return false;
+                    if (!positions)
+                    {
+                        std::memcpy(values.data(), src, count * sizeof(V));
+                        return true;
+                    }
+                    for (size_t k = 0; k < count; k++)
+                        values[positions[k]] = src[k];
+                    return true;
+                }
+            }, column.storage());
+        }
+    }
+
+    FrameLogWriter::FrameLogWriter()
+    {
+    }
+
+    FrameLogWriter::~FrameLogWriter()
+    {
+        close();
+    }
+
+    bool FrameLogWriter::open(const std::string& path, bool delta)
+    {
+        close();
+
+        this->error_.clear();
+        this->out_.open(path, std::ios::binary | std::ios::trunc);
+        if (!this->out_.is_open())
+        {
+            this->error_ = "Open file error.";
+            return false;
+        }
+        FrameLogHeader header;
+        this->out_.write((const char*)&header, sizeof(header));
+
+        this->delta_ = delta;
+        this->frames_ = 0;
+        this->start_ns_ = 0;
+        {
+            std::lock_guard<std::mutex> lock(this->lock_);
+            this->open_ = true;
+            this->stop_ = false;
+        }
+        this->thread_ = std::thread(&FrameLogWriter::run, this);
+        return true;
+    }
+
+    bool FrameLogWriter::close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->lock_);
+            if (!this->open_)
+                return this->error_.empty();
+            this->open_ = false;
+            this->stop_ = true;
+        }
+        this->wake_.notify_one();
+        this->room_.notify_all();
+        if (this->thread_.joinable())
+            this->thread_.join();
+
+        this->out_.close();
+        this->previous_.reset();
+        if (this->error_.empty() && !this->out_)
+            this->error_ = "Write file error.";
+        return this->error_.empty();
+    }
+
+    bool FrameLogWriter::isOpen() const
+    {
+        std::lock_guard<std::mutex> lock(this->lock_);
+        return this->open_;
+    }
+
+    void FrameLogWriter::addSnapshot(const ColumnTablePtr& table)
+    {
+        if (!table)
+            return;
+        Pending pending;
+        pending.kind = FrameKind::Snapshot;
+        pending.table = table;
+        push(std::move(pending));
+    }
+
+    void FrameLogWriter::addPatches(const RowPatch* rows, size_t count)
+    {
+        if (!rows || !count)
+            return;
+        Pending pending;
+        pending.kind = FrameKind::Patches;
+        pending.patches.assign(rows, rows + count);
+        push(std::move(pending));
+    }
+
+    void FrameLogWriter::push(Pending&& pending)
+    {
+        std::unique_lock<std::mutex> lock(this->lock_);
+        this->room_.wait(lock, [this]() { return !this->open_ || this->queue_.size() < max_queued_frames; });
+        if (!this->open_)
+            return;
+
+        // stamped in the order of the log
+        uint64_t now = now_ns();
+        if (!this->start_ns_)
+            this->start_ns_ = now;
+        pending.time_ns = now - this->start_ns_;
+        this->queue_.push_back(std::move(pending));
+        this->wake_.notify_one();
+    }
+
+    void FrameLogWriter::run()
+    {
+        while (true)
+        {
+            Pending pending;
+            {
+                std::unique_lock<std::mutex> lock(this->lock_);
+                this->wake_.wait(lock, [this]() { return this->stop_ || !this->queue_.empty(); });
+                if (this->queue_.empty())
+                    return;// stopped, everything queued is written
+                pending = std::move(this->queue_.front());
+                this->queue_.pop_front();
+            }
+            this->room_.notify_one();
+
+            if (this->error_.empty() && !write(pending))
+                this->error_ = "Write file error.";
+        }
+    }
+
+    bool FrameLogWriter::write(const Pending& pending)
+    {
+        FrameRecord record;
+        record.kind = pending.kind;
+        record.time_ns = pending.time_ns;
+        if (FrameKind::Patches == pending.kind)
+        {
+            record.rows = pending.patches.size();
+            record.bytes = pad8(record.rows * sizeof(RowPatch));
+            this->out_.write((const char*)&record, sizeof(record));
+            write_padded(this->out_, pending.patches.data(), record.rows * sizeof(RowPatch));
+            this->frames_++;
+            return (bool)this->out_;
+        }
+
+        // a snapshot close to the previous one is written as its changed rows
+        const ColumnTable& table = *pending.table;
+        const std::vector<int>* positions = nullptr;
+        if (this->delta_ && this->previous_ && (this->previous_->schema() == table.schema()) && (this->previous_->size() == table.size()))
+        {
+            changed_rows(table, *this->previous_, this->changed_);
+            if (this->changed_.size() * 2 < table.size())
+                positions = &this->changed_;
+        }
+
+        record.kind = positions ? FrameKind::Delta : FrameKind::Snapshot;
+        record.columns = (uint32_t)table.columnCount();
+        record.rows = positions ? positions->size() : table.size();
+        record.table_rows = table.size();
+        record.bytes = schema_bytes(table.schema());
+        if (positions)
+            record.bytes += pad8(positions->size() * sizeof(int32_t));
+        for (size_t c = 0; c < table.columnCount(); c++)
+            record.bytes += column_bytes(table.column(c), positions);
+
+        this->out_.write((const char*)&record, sizeof(record));
+        write_schema(this->out_, table.schema());
+        if (positions)
+            write_padded(this->out_, positions->data(), positions->size() * sizeof(int32_t));
+        for (size_t c = 0; c < table.columnCount(); c++)
+            write_column(this->out_, table.column(c), positions);
+
+        this->previous_ = pending.table;
+        this->frames_++;
+        return (bool)this->out_;
+    }
+
+    FrameLogReader::FrameLogReader()
+    {
+    }
+
+    FrameLogReader::~FrameLogReader()
+    {
+        close();
+    }
+
+    bool FrameLogReader::open(const std::string& path)
+    {
+        close();
+        this->error_.clear();
+
+#ifdef _WIN32
+        HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (INVALID_HANDLE_VALUE == file)
+        {
+            this->error_ = "Open file error.";
+            return false;
+        }
+        LARGE_INTEGER size;
+        HANDLE mapping = NULL;
+        if (::GetFileSizeEx(file, &size) && size.QuadPart > 0)
+            mapping = ::CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        ::CloseHandle(file);
+        if (!mapping)
+        {
+            this->error_ = "Map file error.";
+            return false;
+        }
+        this->data_ = (const unsigned char*)::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!this->data_)
+        {
+            ::CloseHandle(mapping);
+            this->error_ = "Map file error.";
+            return false;
+        }
+        this->handle_ = mapping;
+        this->size_ = (size_t)size.QuadPart;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            this->error_ = "Open file error.";
+            return false;
+        }
+        struct stat st;
+        void* map = MAP_FAILED;
+        if (0 == ::fstat(fd, &st) && st.st_size > 0)
+            map = ::mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (MAP_FAILED == map)
+        {
+            this->error_ = "Map file error.";
+            return false;
+        }
+        this->data_ = (const unsigned char*)map;
+        this->size_ = (size_t)st.st_size;
+#endif
+
+        FrameLogHeader expected;
+        const FrameLogHeader* header = (const FrameLogHeader*)this->data_;
+        if (this->size_ < sizeof(FrameLogHeader) || 0 != std::memcmp(header->magic, expected.magic, sizeof(expected.magic))
+            || header->version != expected.version || header->byte_order != expected.byte_order)
+        {
+            close();
+            this->error_ = "Not a frame log of this version and byte order.";
+            return false;
+        }
+
+        // only the record headers are read, a record cut short ends the log
+        size_t offset = sizeof(FrameLogHeader);
+        while (this->size_ - offset >= sizeof(FrameRecord))
+        {
+            const FrameRecord* record = (const FrameRecord*)(this->data_ + offset);
+            if (record->kind < FrameKind::Snapshot || record->kind > FrameKind::Patches || (record->bytes % 8)
+                || record->bytes > this->size_ - offset - sizeof(FrameRecord))
+                break;
+            this->records_.push_back(record);
+            offset += sizeof(FrameRecord) + record->bytes;
+        }
+        return true;
+    }
+
+    void FrameLogReader::close()
+    {
+        if (this->data_)
+        {
+#ifdef _WIN32
+            ::UnmapViewOfFile(this->data_);
+            ::CloseHandle((HANDLE)this->handle_);
+#else
+            ::munmap((void*)this->data_, this->size_);
+#endif
+        }
+        this->data_ = nullptr;
+        this->size_ = 0;
+        this->handle_ = nullptr;
+        this->records_.clear();
+    }
+
+    Schema FrameLogReader::schema(size_t i) const
+    {
+        Schema schema;
+        const FrameRecord& rec = record(i);
+        if (FrameKind::Patches == rec.kind)
+            return schema;
+        Cursor cursor = { payload(i), payload(i) + rec.bytes, true };
+        if (!read_schema(cursor, rec.columns, schema))
+            schema.clear();
+        return schema;
+    }
+
+    bool FrameLogReader::read(size_t i, ColumnTable& table, const ColumnTable* previous) const
+    {
+        const FrameRecord& rec = record(i);
+        if (FrameKind::Patches == rec.kind)
+            return false;
+
+        Cursor cursor = { payload(i), payload(i) + rec.bytes, true };
+        Schema schema;
+        if (!read_schema(cursor, rec.columns, schema))
+            return false;
+
+        // the rows have to fit the payload left before the table is sized for them, a delta lists
+        // the position of each row first
+        size_t row = row_bytes(schema) + ((FrameKind::Snapshot == rec.kind) ? 0 : sizeof(int32_t));
+        if (row && (rec.rows > (size_t)(cursor.end - cursor.p) / row))
+            return false;
+
+        if (FrameKind::Snapshot == rec.kind)
+        {
+            table.setSchema(schema);
+            table.resize(rec.rows);
+            for (size_t c = 0; c < table.columnCount(); c++)
+            {
+                if (!read_column(cursor, table.column(c), rec.rows, nullptr))
+                    return false;
+            }
+            return true;
+        }
+
+        // delta: the previous table with the changed rows written over
+        if (!previous || (previous->schema() != schema) || (previous->size() != rec.table_rows))
+            return false;
+        const int32_t* positions = (const int32_t*)cursor.take(rec.rows * sizeof(int32_t));
+        if (!cursor.ok)
+            return false;
+        for (size_t k = 0; k < rec.rows; k++)
+        {
+            if (positions[k] < 0 || (uint64_t)positions[k] >= rec.table_rows)
+                return false;
+        }
+        if (&table != previous)
+            table = *previous;
+        for (size_t c = 0; c < table.columnCount(); c++)
+        {
+            if (!read_column(cursor, table.column(c), rec.rows, positions))
+                return false;
+        }
+        return true;
+    }
+
+    const RowPatch* FrameLogReader::patches(size_t i) const
+    {
+        if (FrameKind::Patches != record(i).kind)
+            return nullptr;
+        if (record(i).rows > record(i).bytes / sizeof(RowPatch))
+            return nullptr;
+        return (const RowPatch*)payload(i);
+    }
+
+    size_t replay_frame_log(const FrameLogReader& log, double speed, const std::atomic<bool>& stop, const FrameLogTarget& target)
+    {
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point start = Clock::now();
+        ColumnTable base;// the last snapshot, deltas are applied to it
+        bool has_base = false;
+        size_t published = 0;
+        for (size_t i = 0; i < log.size() && !stop; i++)
+        {
+            const FrameRecord& rec = log.record(i);
+            // a long pause of the recording is waited in slices, stop is seen meanwhile
+            Clock::time_point due = start + std::chrono::nanoseconds((long long)(speed > 0 ? rec.time_ns / speed : 0));
+            while (!stop && Clock::now() < due)
+                std::this_thread::sleep_for(std::min<Clock::duration>(due - Clock::now(), std::chrono::milliseconds(100)));
+            if (stop)
+                break;
+
+            if (FrameKind::Patches == rec.kind)
+            {
+                const RowPatch* rows = log.patches(i);
+                if (rows && target.updateRows)
+                    target.updateRows(rows, (size_t)rec.rows);
+                published++;
+                continue;
+            }
+
+            if (!log.read(i, base, has_base ? &base : nullptr))
+            {
+                has_base = false;// a delta without its base is skipped
+                continue;
+            }
+            has_base = true;
+
+            // the published table is the producer's own, base stays untouched by the patches of the sheet
+            ColumnTablePtr table = target.acquire ? target.acquire(base.schema(), base.size()) : std::make_shared<ColumnTable>();
+            *table = base;
+            if (target.update)
+                target.update(table);
+            published++;
+        }
+        return published;
+    }
+}
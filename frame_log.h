@@ -0,0 +1,156 @@
+#ifndef FRAME_LOG_H
+#define FRAME_LOG_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "column_table.h"
+
+namespace tool
+{
+    // binary log of the frames published to a SpreadSheet, in the byte order of the machine writing it:
+    // a FrameLogHeader, then one FrameRecord per Update or UpdateRows, each followed by its payload.
+    // every record and every array in it starts at a multiple of 8 bytes, a mapped log is read in place.
+    //   Snapshot: schema, then one array per column of rows values
+    //   Delta:    schema, rows int32 positions, then one array per column of the values at these positions,
+    //             applied on the previous snapshot (table_rows rows, the same schema)
+    //   Patches:  rows RowPatch
+    // the schema is per column uint32 type, uint32 name length and the name; a string column is
+    // rows uint32 lengths and the characters
+    typedef struct FrameLogHeader {
+        char magic[8] = { 'S', 'S', 'F', 'R', 'A', 'M', 'E', 0 };
+        uint32_t version = 1;
+        uint32_t byte_order = 0x01020304;
+    }FrameLogHeader;
+
+    enum class FrameKind : uint32_t
+    {
+        Snapshot = 1,
+        Delta = 2,
+        Patches = 3,
+    };
+
+    typedef struct FrameRecord {
+        FrameKind kind = FrameKind::Snapshot;
+        uint32_t columns = 0;
+        uint64_t time_ns = 0;// since the first record
+        uint64_t rows = 0;// rows of the snapshot, changed rows of the delta, patch count
+        uint64_t table_rows = 0;// rows of the table after the record (snapshot and delta)
+        uint64_t bytes = 0;// payload after the record
+    }FrameRecord;
+
+    // appends frames to a log on its own thread, the producers only queue them. thread safe
+    class FrameLogWriter
+    {
+    public:
+        FrameLogWriter();
+        ~FrameLogWriter();// close
+
+        FrameLogWriter(const FrameLogWriter&) = delete;
+        FrameLogWriter& operator=(const FrameLogWriter&) = delete;
+
+        // start a new log at path, with delta snapshots of the same schema and size as the previous one
+        // are stored as the changed rows only (if less than half of them changed)
+        bool open(const std::string& path, bool delta = true);
+
+        // write what is queued and stop, false if a write failed
+        bool close();
+
+        bool isOpen() const;
+        const std::string& error() const { return error_; }
+
+        // the table is kept until written, it must not be changed after the call (as with SpreadSheet::Update).
+        // a producer waits while too many frames are queued, nothing is dropped
+        void addSnapshot(const ColumnTablePtr& table);
+        void addPatches(const RowPatch* rows, size_t count);
+
+        // frames written so far
+        unsigned long long frames() const { return frames_.load(); }
+
+    private:
+        typedef struct Pending {
+            FrameKind kind = FrameKind::Snapshot;
+            uint64_t time_ns = 0;
+            ColumnTablePtr table;
+            std::vector<RowPatch> patches;
+        }Pending;
+
+        void push(Pending&& pending);
+        void run();
+        bool write(const Pending& pending);
+
+        std::ofstream out_;
+        bool delta_ = true;
+        std::string error_;
+        std::atomic<unsigned long long> frames_{ 0 };
+        ColumnTablePtr previous_;// last snapshot written, base of the next delta
+        std::vector<int> changed_;
+
+        mutable std::mutex lock_;
+        std::condition_variable wake_;// writer: frames queued or stop
+        std::condition_variable room_;// producers: the queue has room
+        std::deque<Pending> queue_;
+        bool open_ = false;
+        bool stop_ = false;
+        uint64_t start_ns_ = 0;
+        std::thread thread_;
+    };
+
+    // memory mapped log, the records are found once on open, the frames are read in place
+    class FrameLogReader
+    {
+    public:
+        FrameLogReader();
+        ~FrameLogReader();
+
+        FrameLogReader(const FrameLogReader&) = delete;
+        FrameLogReader& operator=(const FrameLogReader&) = delete;
+
+        // map path, a log cut short (the recording was killed) keeps its complete records
+        bool open(const std::string& path);
+        void close();
+        const std::string& error() const { return error_; }
+
+        size_t size() const { return records_.size(); }
+        const FrameRecord& record(size_t i) const { return *records_[i]; }
+
+        // schema of a snapshot or delta record
+        Schema schema(size_t i) const;
+
+        // fill table with the snapshot of record i, a delta needs the table of the record before it
+        // in previous. false if the delta does not fit previous or the record is corrupt
+        bool read(size_t i, ColumnTable& table, const ColumnTable* previous = nullptr) const;
+
+        // the patches of a Patches record, record(i).rows of them, inside the mapping
+        const RowPatch* patches(size_t i) const;
+
+    private:
+        const unsigned char* payload(size_t i) const { return (const unsigned char*)(records_[i] + 1); }
+
+        std::string error_;
+        const unsigned char* data_ = nullptr;
+        size_t size_ = 0;
+        void* handle_ = nullptr;// platform mapping
+        std::vector<const FrameRecord*> records_;
+    };
+
+    // called by replay_frame_log, on its thread
+    typedef struct FrameLogTarget {
+        std::function<ColumnTablePtr(const Schema& schema, size_t rows)> acquire;// a table to fill, e.g. SpreadSheet::acquireTable
+        std::function<void(ColumnTablePtr& table)> update;// SpreadSheet::Update
+        std::function<void(const RowPatch* rows, size_t count)> updateRows;// SpreadSheet::UpdateRows
+    }FrameLogTarget;
+
+    // publish the frames of log to target at their recorded times divided by speed, speed 0 as fast as
+    // possible. blocks until the end or stop, return the frames published
+    size_t replay_frame_log(const FrameLogReader& log, double speed, const std::atomic<bool>& stop, const FrameLogTarget& target);
+}
+
+#endif // FRAME_LOG_H
@@ -0,0 +1,109 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+namespace tool
+{
+    // durations of the last window samples, in milliseconds.
+    // buckets counts them by powers of two of microseconds: bucket b holds [2^(b-1), 2^b) us, bucket 0 below 1 us
+    class RollingHistogram
+    {
+    public:
+        static const int bucket_count = 24;// up to about 8 s
+
+        RollingHistogram(size_t window = 256) : samples_(window, 0.0f) {}
+
+        void add(double ms)
+        {
+            if (this->samples_.empty())
+                return;
+            this->samples_[this->next_] = (float)ms;
+            this->next_ = (this->next_ + 1) % this->samples_.size();
+            this->count_ = std::min(this->count_ + 1, this->samples_.size());
+            this->total_++;
+        }
+
+        // samples in the window, and since the start
+        size_t count() const { return this->count_; }
+        unsigned long long total() const { return this->total_; }
+
+        double mean() const
+        {
+            if (!this->count_)
+                return 0.0;
+            double sum = 0.0;
+            for (size_t i = 0; i < this->count_; i++)
+                sum += this->samples_[i];
+            return sum / this->count_;
+        }
+
+        double max() const
+        {
+            if (!this->count_)
+                return 0.0;
+            return *std::max_element(this->samples_.begin(), this->samples_.begin() + this->count_);
+        }
+
+        // q in [0, 1], 0.5 is the median
+        double percentile(double q) const
+        {
+            if (!this->count_)
+                return 0.0;
+            std::vector<float> sorted(this->samples_.begin(), this->samples_.begin() + this->count_);
+            size_t k = std::min(this->count_ - 1, (size_t)(q * this->count_));
+            std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+            return sorted[k];
+        }
+
+        std::array<unsigned, bucket_count> buckets() const
+        {
+            std::array<unsigned, bucket_count> buckets = {};
+            for (size_t i = 0; i < this->count_; i++)
+            {
+                double us = this->samples_[i] * 1000.0;
+                int b = (us < 1.0) ? 0 : 1 + (int)std::log2(us);
+                buckets[std::min(b, bucket_count - 1)]++;
+            }
+            return buckets;
+        }
+
+    private:
+        std::vector<float> samples_;
+        size_t next_ = 0;
+        size_t count_ = 0;
+        unsigned long long total_ = 0;
+    };
+
+    // instrumentation of the update pipeline, see SpreadSheet::frameStats
+    typedef struct FrameStats {
+        unsigned long long published = 0;// snapshots passed to Update
+        unsigned long long dropped = 0;// snapshots replaced in the mailbox before the page builder took them
+        unsigned long long patch_batches = 0;// UpdateRows calls
+        unsigned long long requests = 0;// tableUpdate signals, merged into frames
+        unsigned long long frames = 0;// pages shown
+        size_t queue_depth = 0;// snapshot (0 or 1) and patch batches waiting now
+
+        // per frame stages, take to format on the page builder, rows and model on the GUI thread
+        RollingHistogram take;// taking the snapshot and writing the patches
+        RollingHistogram roi;// checking the rows of interest and filtering
+        RollingHistogram sort;
+        RollingHistogram format;// the text of the viewport
+        RollingHistogram rows;// adjustRows and the visible range
+        RollingHistogram model;// setPage and the dataChanged of the visible rows
+        RollingHistogram gui;// GUI thread time of a frame, its request and showing its page
+        RollingHistogram total;// from the request to the page on display
+        RollingHistogram interval;// between two frames
+    }FrameStats;
+
+    inline double elapsed_ms(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+    {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+}
+
+#endif // FRAME_STATS_H
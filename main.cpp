@@ -7,13 +7,23 @@
 #include <chrono>
 #include <iostream>
 #include <random>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
 #include "spread_sheet.h"
+#include "frame_log.h"
 using namespace std::chrono_literals;
 
 tool::SpreadSheet* ss = NULL;
-bool need_stop = false;
+std::atomic<bool> need_stop(false);
 const int COLUMN = 102400;
 
+// command line: [--record FILE] [--replay FILE [--speed X]] [--history N]
+std::string record_path;// every frame published is appended to this log
+std::string replay_path;// frames of this log are shown instead of random ones
+double replay_speed = 1.0;// 2 plays twice as fast, 0 as fast as possible
+int history_depth = 0;// values per row of the sparkline column, 0 for none
+
 void Producer()
 {
     while (!need_stop)
@@ -22,7 +32,7 @@ void Producer()
         std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
         std::uniform_int_distribution<> distrib(1, 102400);
 
-        tool::DatasPtr datas(new tool::Datas(COLUMN));
+        tool::DatasPtr datas = ss->acquireBuffer(COLUMN);
         for (int i = 0; i < datas->size(); i++)
         {
             tool::DataStruct& data = datas->at(i);
@@ -37,17 +47,57 @@ void Producer()
     }
 }
 
+// publish the frames of replay_path at their recorded pace
+void Replayer()
+{
+    tool::FrameLogReader log;
+    if (!log.open(replay_path))
+    {
+        std::cerr << replay_path << ": " << log.error() << std::endl;
+        return;
+    }
+
+    tool::FrameLogTarget target;
+    target.acquire = [](const tool::Schema& schema, size_t rows) { return ss->acquireTable(schema, rows); };
+    target.update = [](tool::ColumnTablePtr& table) { ss->Update(table); };
+    target.updateRows = [](const tool::RowPatch* rows, size_t count) { ss->UpdateRows(rows, count); };
+    tool::replay_frame_log(log, replay_speed, need_stop, target);
+}
+
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--record"))
+            record_path = argv[++i];
+        else if (0 == strcmp(argv[i], "--replay"))
+            replay_path = argv[++i];
+        else if (0 == strcmp(argv[i], "--speed"))
+            replay_speed = std::atof(argv[++i]);
+        else if (0 == strcmp(argv[i], "--history"))
+            history_depth = std::atoi(argv[++i]);
+    }
+
 	QApplication a(argc, argv);
     QCoreApplication::setAttribute(Qt::AA_UseHighDpiPixmaps);
     QApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
 
     QMainWindow* w = new QMainWindow(NULL);
     ss = new tool::SpreadSheet(COLUMN, 4, w);
+    ss->setSortMode(tool::SpreadSheet::SortVisibleRows);
+    ss->setRowHistory(history_depth, COLUMN);
     w->setCentralWidget(ss);
     w->show();
 
-    std::shared_ptr<std::thread> th(new std::thread(Producer));
-    return a.exec();
+    if (record_path.size() && !ss->startRecording(QString::fromStdString(record_path)))
+        std::cerr << record_path << ": can not record" << std::endl;
+
+    std::shared_ptr<std::thread> th(new std::thread(replay_path.size() ? Replayer : Producer));
+    int ret = a.exec();
+
+    // the log gets the frames still queued
+    need_stop = true;
+    th->join();
+    ss->stopRecording();
+    return ret;
 }
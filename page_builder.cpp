@@ -0,0 +1,913 @@
+#include "page_builder.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <variant>
+#include "frame_stats.h"
+#include "radix_sort.h"
+#include "row_format.h"
+
+namespace tool
+{
+    namespace
+    {
+        // spare snapshots to write patches into: the one of the page before and one more while the GUI
+        // has not taken the last page yet
+        const size_t max_spares = 2;
+
+        // queued patch batches a producer starts to merge at (PageBuilder::collapsePatches)
+        const size_t collapse_batches = 64;
+
+        // the same rows in the same order and text, only the viewport may differ
+        bool same_order(const PageRequest& l, const PageRequest& r)
+        {
+            return (l.sort_keys == r.sort_keys) && (l.visible_only == r.visible_only) && (l.roi_mode == r.roi_mode)
+                && (!l.roi_mode || (l.roi == r.roi)) && (l.filter == r.filter) && (l.decimals == r.decimals);
+        }
+
+        // the text of the display rows [first, first + count) in the order of page, numbers through
+        // std::to_chars, no QString is made. rows previous has formatted (a page of the same rows,
+        // order and decimals) are taken from it
+        void format_rows(Page& page, int first, int count, const Page* previous)
+        {
+            const ColumnTable& data = *page.data;
+            int columns = (int)data.columnCount();
+            page.first = first;
+            page.count = count;
+            page.columns = columns;
+            page.cells.assign((size_t)count * columns, CellText());
+            for (int r = first; r < first + count; r++)
+            {
+                if (r < page.sorted_first || r > page.sorted_last)
+                    continue;// shown as "..."
+                CellText* cells = &page.cells[(size_t)(r - first) * columns];
+                if (previous && (r >= previous->first) && (r < previous->first + previous->count))
+                {
+                    const CellText* kept = &previous->cells[(size_t)(r - previous->first) * columns];
+                    std::copy(kept, kept + columns, cells);
+                    continue;
+                }
+                size_t data_row = (*page.index)[r];
+                if (page.rows)
+                    data_row = (*page.rows)[data_row];
+                for (int c = 0; c < columns; c++)
+                {
+                    const Column& column = data.column(c);
+                    if (ColumnType::String == column.type())
+                        continue;
+                    CellText& cell = cells[c];
+                    char* end = format_cell(cell.text, cell.text + sizeof(cell.text), column, data_row, column_decimals(page.decimals, c));
+                    cell.size = (unsigned char)(end - cell.text);
+                    cell.held = (end != cell.text);
+                }
+            }
+        }
+
+        // the cells of the rows of page changed since previous (the last page) get the time now, the others
+        // keep the time previous has for them. only the rows of the viewport are compared, one column at a time
+        void track_changes(Page& page, const Page* previous, int fade_ms)
+        {
+            const size_t cells = page.cells.size();
+            const int columns = page.columns;
+            page.change_ms.assign(cells, 0);
+            page.changed.assign((cells + 63) / 64, 0);
+            if (!previous || !columns)
+                return;
+
+            // data rows of the viewport, those out of the ordered window are not shown
+            std::vector<std::pair<size_t, int> > rows;// data row, row in the cells of page
+            for (int r = std::max(page.first, page.sorted_first); r < page.first + page.count && r <= page.sorted_last; r++)
+            {
+                size_t data_row = (*page.index)[r];
+                if (page.rows)
+                    data_row = (*page.rows)[data_row];
+                rows.push_back({ data_row, r - page.first });
+            }
+
+            // the times previous has, looked up by data row
+            if (previous->change_ms.size() == previous->cells.size() && (previous->columns == columns))
+            {
+                std::vector<std::pair<size_t, int> > kept;
+                for (int r = std::max(previous->first, previous->sorted_first); r < previous->first + previous->count && r <= previous->sorted_last; r++)
+                {
+                    size_t data_row = (*previous->index)[r];
+                    if (previous->rows)
+                        data_row = (*previous->rows)[data_row];
+                    kept.push_back({ data_row, r - previous->first });
+                }
+                std::sort(kept.begin(), kept.end());
+                for (auto& it : rows)
+                {
+                    auto found = std::lower_bound(kept.begin(), kept.end(), std::make_pair(it.first, 0));
+                    if (found == kept.end() || found->first != it.first)
+                        continue;
+                    const uint32_t* from = &previous->change_ms[(size_t)found->second * columns];
+                    std::copy(from, from + columns, &page.change_ms[(size_t)it.second * columns]);
+                }
+            }
+
+            // values compared bit for bit, a NaN that stays NaN is no change
+            const uint32_t now = change_clock_ms();
+            const ColumnTable& data = *page.data;
+            const ColumnTable& old = *previous->data;
+            if (&data != &old)
+            {
+                size_t old_size = old.size();
+                int compared = std::min(columns, (int)old.columnCount());
+                for (int c = 0; c < compared; c++)
+                {
+                    std::visit([&](const auto& values, const auto& old_values) {
+                        using V = typename std::decay<decltype(values)>::type;
+                        using O = typename std::decay<decltype(old_values)>::type;
+                        if constexpr (std::is_same<V, O>::value)
+                        {
+                            for (auto& it : rows)
+                            {
+                                if (it.first >= old_size)
+                                    continue;
+                                bool same;
+                                if constexpr (std::is_same<typename V::value_type, std::string>::value)
+                                    same = (values[it.first] == old_values[it.first]);
+                                else
+                                    same = !std::memcmp(&values[it.first], &old_values[it.first], sizeof(values[it.first]));
+                                if (!same)
+                                    page.change_ms[(size_t)it.second * columns + c] = now;
+                            }
+                        }
+                    }, data.column(c).storage(), old.column(c).storage());
+                }
+            }
+
+            for (size_t i = 0; i < cells; i++)
+            {
+                uint32_t t = page.change_ms[i];
+                if (!t || (now - t >= (uint32_t)fade_ms))
+                    continue;
+                page.changed[i / 64] |= 1ull << (i % 64);
+                page.last_change_ms = std::max(page.last_change_ms, t);
+            }
+        }
+
+        // the last values of the rows of the viewport from history, by the idx of their data (legacy layout)
+        void sample_history(Page& page, const RowHistory& history, int column)
+        {
+            const ColumnTable& data = *page.data;
+            if (data.schema() != ColumnTable::legacySchema())
+                return;
+
+            std::vector<int> idxs(page.count, -1);
+            const std::vector<int32_t>& idx = data.column(0).values<int32_t>();
+            for (int r = std::max(page.first, page.sorted_first); r < page.first + page.count && r <= page.sorted_last; r++)
+            {
+                size_t data_row = (*page.index)[r];
+                if (page.rows)
+                    data_row = (*page.rows)[data_row];
+                idxs[r - page.first] = idx[data_row];
+            }
+
+            page.history_column = std::min(std::max(column, 1), 3);
+            page.history_depth = history.depth();
+            page.history.resize((size_t)page.count * page.history_depth);
+            page.history_sizes.resize(page.count);
+            history.read(idxs.data(), idxs.size(), page.history_column, page.history.data(), page.history_sizes.data());
+        }
+    }
+
+    uint32_t change_clock_ms()
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch).count() + 1;
+    }
+
+    int column_decimals(const std::vector<int>& decimals, int column)
+    {
+        if (column < 0 || column >= (int)decimals.size() || decimals[column] < 0)
+            return default_decimals;
+        return decimals[column];
+    }
+
+    // the order of the radix sort for a value, NaN included (above +inf, a negative one below -inf),
+    // so that the comparison sorts get a strict weak order and the same result. strings as they are
+    template <typename T>
+    inline auto order_key(const T& v) -> decltype(radix_key(v))
+    {
+        return radix_key(v);
+    }
+
+    inline const std::string& order_key(const std::string& v)
+    {
+        return v;
+    }
+
+    // http://www.cplusplus.com/forum/beginner/116101/
+    template <typename Container>
+    struct compare_indirect_index
+    {
+        const Container& container;
+        compare_indirect_index(const Container& container) : container(container) { }
+        bool operator () (size_t lindex, size_t rindex) const
+        {
+            return order_key(container[lindex]) < order_key(container[rindex]);
+        }
+    };
+
+    template <typename Container>
+    void sort_data(Container& v, std::vector<size_t>& idx, bool is_ascend = true)
+    {
+        // numeric keys: parallel radix sort, same permutation
+        using Value = typename std::decay<decltype(v[0])>::type;
+        if constexpr (is_radix_sortable<Value>::value)
+        {
+            if ((idx.size() >= radix_min_size) && (idx.size() == v.size()) && (idx.size() < 0xFFFFFFFFull))
+            {
+                radix_sort_indexes(v, idx, is_ascend);
+                return;
+            }
+        }
+
+        // initialize original index locations
+        iota(idx.begin(), idx.end(), 0);
+
+        // sort indexes based on comparing values in v
+        // using std::stable_sort instead of std::sort
+        // to avoid unnecessary index re-orderings
+        // when v contains elements of equal values
+        std::stable_sort(idx.begin(), idx.end(), compare_indirect_index <decltype(v)>(v));
+        if (!is_ascend)
+        {
+            std::reverse(idx.begin(), idx.end());
+        }
+        return;
+    }
+
+    // strict order of the stable sort: equal values keep their index order,
+    // descending is the reverse of the ascending stable sort
+    template <typename Container>
+    struct compare_rank_index
+    {
+        const Container& container;
+        bool is_ascend;
+        compare_rank_index(const Container& container, bool is_ascend) : container(container), is_ascend(is_ascend) { }
+        bool operator () (size_t lindex, size_t rindex) const
+        {
+            const auto& l = order_key(container[lindex]);
+            const auto& r = order_key(container[rindex]);
+            if (l < r)
+                return is_ascend;
+            if (r < l)
+                return !is_ascend;
+            return is_ascend ? (lindex < rindex) : (rindex < lindex);
+        }
+    };
+
+    // only the ranks [first, last] are placed, the same as sort_data does,
+    // the other positions of idx are left in no order
+    template <typename Container>
+    void sort_data_window(Container& v, std::vector<size_t>& idx, int first, int last, bool is_ascend = true)
+    {
+        // initialize original index locations
+        iota(idx.begin(), idx.end(), 0);
+
+        int size = (int)idx.size();
+        if (first < 0)
+            first = 0;
+        if (last >= size)
+            last = size - 1;
+        if (first > last)
+            return;
+
+        // select the rank first, then order the window behind it. the comparator is the order of
+        // sort_data (NaN included), the window shows the ranks SortAllRows would
+        compare_rank_index<Container> cmp(v, is_ascend);
+        if (first > 0)
+            std::nth_element(idx.begin(), idx.begin() + first, idx.end(), cmp);
+        std::partial_sort(idx.begin() + first, idx.begin() + last + 1, idx.end(), cmp);
+        return;
+    }
+
+    // idx was sorted before the dirty rows changed, the clean rows are still in order:
+    // they are kept, the dirty rows are sorted and merged back, the result is the one of sort_data.
+    // merge is a scratch buffer
+    template <typename Container>
+    void repair_sorted(Container& v, std::vector<size_t>& idx, const std::vector<unsigned char>& dirty_mark,
+        std::vector<size_t> dirty_rows, std::vector<size_t>& merge, bool is_ascend = true)
+    {
+        compare_rank_index<Container> cmp(v, is_ascend);
+
+        // drop the dirty rows, the clean ones keep their order
+        size_t kept = 0;
+        for (size_t i = 0; i < idx.size(); i++)
+        {
+            if (!dirty_mark[idx[i]])
+                idx[kept++] = idx[i];
+        }
+        std::sort(dirty_rows.begin(), dirty_rows.end(), cmp);
+
+        merge.resize(idx.size());
+        std::merge(idx.begin(), idx.begin() + kept, dirty_rows.begin(), dirty_rows.end(), merge.begin(), cmp);
+        idx.swap(merge);
+        return;
+    }
+
+    // idx is the permutation of the previous frame and prev its keys, most keys did not change:
+    // the rows of changed keys are taken out, sorted and merged back, the others kept their order.
+    // return false (idx is not touched) if more than max_displaced keys changed, then a full sort is cheaper
+    template <typename Container, typename Keys>
+    bool resort_adaptive(Container& v, Keys& prev, std::vector<size_t>& idx, std::vector<unsigned char>& mark,
+        std::vector<size_t>& displaced, std::vector<size_t>& merge, size_t max_displaced, bool is_ascend = true)
+    {
+        size_t size = v.size();
+        if ((prev.size() != size) || (idx.size() != size))
+            return false;
+
+        displaced.clear();
+        for (size_t i = 0; i < size; i++)
+        {
+            if (order_key(v[i]) == order_key(prev[i]))
+                continue;// by the bits of the key, a NaN that stays NaN did not move
+            displaced.push_back(i);
+            if (displaced.size() > max_displaced)
+                return false;
+        }
+        if (displaced.empty())
+            return true;
+
+        mark.assign(size, 0);
+        for (auto& r : displaced)
+            mark[r] = 1;
+        repair_sorted(v, idx, mark, displaced, merge, is_ascend);
+        return true;
+    }
+
+    // order index by the column key directly on its array, no values are gathered.
+    // with rows only the listed rows are ordered, index holds positions in rows.
+    // with window only the ranks [first, last] are placed
+    void sort_by_column(const Column& key, const RowSet* rows, std::vector<size_t>& index, bool is_ascend, bool window = false, int first = 0, int last = -1)
+    {
+        std::visit([&](const auto& values) {
+            using V = typename std::decay<decltype(values)>::type::value_type;
+            auto sort = [&](const auto& keys) {
+                if (window)
+                    sort_data_window(keys, index, first, last, is_ascend);
+                else
+                    sort_data(keys, index, is_ascend);
+            };
+            if (rows)
+                sort(RowView<V>(values, *rows));
+            else
+                sort(values);
+        }, key.storage());
+    }
+
+    bool resort_by_column(const Column& key, const RowSet* rows, const Column& previous_key, std::vector<size_t>& index, std::vector<unsigned char>& mark,
+        std::vector<size_t>& displaced, std::vector<size_t>& merge, size_t max_displaced, bool is_ascend)
+    {
+        return std::visit([&](const auto& values, const auto& previous) {
+            using V = typename std::decay<decltype(values)>::type;
+            using P = typename std::decay<decltype(previous)>::type;
+            if constexpr (std::is_same<V, P>::value)
+            {
+                if (rows)
+                {
+                    const RowView<typename V::value_type> view(values, *rows);
+                    return resort_adaptive(view, previous, index, mark, displaced, merge, max_displaced, is_ascend);
+                }
+                return resort_adaptive(values, previous, index, mark, displaced, merge, max_displaced, is_ascend);
+            }
+            else
+            {
+                return false;
+            }
+        }, key.storage(), previous_key.storage());
+    }
+
+    void repair_by_column(const Column& key, std::vector<size_t>& index, const std::vector<unsigned char>& dirty_mark,
+        const std::vector<size_t>& dirty_rows, std::vector<size_t>& merge, bool is_ascend)
+    {
+        std::visit([&](const auto& values) {
+            repair_sorted(values, index, dirty_mark, dirty_rows, merge, is_ascend);
+        }, key.storage());
+    }
+
+    // keys of the sorted rows by position (in rows if set), the next frame finds the moved rows by them
+    void keep_keys(const Column& key, const RowSet* rows, Column& keys)
+    {
+        if (keys.type() != key.type())
+            keys = Column(key.type());
+        std::visit([&](const auto& values, auto& kept) {
+            using V = typename std::decay<decltype(values)>::type;
+            using K = typename std::decay<decltype(kept)>::type;
+            if constexpr (std::is_same<V, K>::value)
+            {
+                if (!rows)
+                {
+                    kept = values;
+                    return;
+                }
+                kept.resize(rows->size());
+                for (size_t i = 0; i < rows->size(); i++)
+                    kept[i] = values[(*rows)[i]];
+            }
+        }, key.storage(), keys.storage());
+    }
+
+    void sort_by_keys(const ColumnTable& table, const SortKeys& keys, const RowSet* rows, std::vector<size_t>& index)
+    {
+        CompositeKey composite;
+        bool is_ascend = true;
+        const Column& key = composite.build(table, keys, is_ascend);
+        sort_by_column(key, rows, index, is_ascend);
+    }
+
+    PageBuilder::PageBuilder(const WorkerPool::GroupPtr& group, const std::shared_ptr<BufferPool<ColumnTable> >& table_pool, Ready ready)
+        : group_(group)
+        , table_pool_(table_pool)
+        , row_pool_(new BufferPool<RowSet>())
+        , index_pool_(new BufferPool<std::vector<size_t> >())
+        , state_(std::make_shared<State>())
+    {
+        this->state_->ready = std::move(ready);
+    }
+
+    PageBuilder::~PageBuilder()
+    {
+        std::unique_lock<std::mutex> lock(this->state_->lock);
+        this->state_->stop = true;
+        this->state_->request = PageRequest();
+        this->state_->idle.wait(lock, [this]() { return !this->state_->running; });
+    }
+
+    bool PageBuilder::publish(const ColumnTablePtr& table)
+    {
+        bool woken = this->data_.publish(table);
+        if (!woken)
+            this->dropped_++;
+
+        // the snapshot has the patches queued before it
+        if (this->pending_batches_.load())
+            collapsePatches(table->sequence(), false);
+        return woken;
+    }
+
+    bool PageBuilder::pushPatches(RowPatchBatch&& batch)
+    {
+        // counted before the push, a take right after it must not count below zero
+        this->pending_rows_ += batch.rows.size();
+        this->pending_batches_++;
+        bool woken = this->patches_.push(std::move(batch));
+
+        // no one took the queue for a while (a paused sheet)
+        if (this->pending_batches_.load() > collapse_batches)
+            collapsePatches(0, true);
+        return woken;
+    }
+
+    void PageBuilder::collapsePatches(unsigned long long sequence, bool grown)
+    {
+        std::unique_lock<std::mutex> lock(this->patch_lock_, std::try_to_lock);
+        if (!lock.owns_lock())
+            return;
+        if (grown && (this->pending_rows_.load() < 2 * this->collapsed_rows_))
+            return;
+
+        std::vector<RowPatchBatch> batches = this->patches_.takeAll();
+        if (batches.empty())
+            return;
+        std::sort(batches.begin(), batches.end(), [](const RowPatchBatch& l, const RowPatchBatch& r) {
+            return l.sequence < r.sequence;
+        });
+
+        size_t taken_rows = 0;
+        RowPatchBatch merged;
+        for (auto& batch : batches)
+        {
+            taken_rows += batch.rows.size();
+            if (batch.sequence < sequence)
+                continue;
+            merged.sequence = batch.sequence;
+            merged.rows.insert(merged.rows.end(), batch.rows.begin(), batch.rows.end());
+        }
+
+        // the last patch of each row wins, as if the batches were written one after another
+        std::stable_sort(merged.rows.begin(), merged.rows.end(), [](const RowPatch& l, const RowPatch& r) {
+            return l.row < r.row;
+        });
+        size_t kept = 0;
+        for (size_t i = 0; i < merged.rows.size(); i++)
+        {
+            if (i + 1 < merged.rows.size() && merged.rows[i + 1].row == merged.rows[i].row)
+                continue;
+            merged.rows[kept++] = merged.rows[i];
+        }
+        merged.rows.resize(kept);
+
+        this->collapsed_rows_ = kept;
+        this->pending_rows_ -= taken_rows - kept;
+        this->pending_batches_ -= batches.size();
+        if (kept)
+        {
+            this->pending_batches_++;
+            this->patches_.push(std::move(merged));
+        }
+    }
+
+    void PageBuilder::request(const PageRequest& request)
+    {
+        std::shared_ptr<State> state = this->state_;
+        {
+            std::lock_guard<std::mutex> lock(state->lock);
+            state->request = request;
+            state->pending = true;
+            if (state->scheduled)
+                return;// the queued or running task takes it
+            state->scheduled = true;
+        }
+        PageBuilder* builder = this;
+        this->group_->submit([builder, state]() { run(builder, state); });
+    }
+
+
+    void PageBuilder::run(PageBuilder* builder, const std::shared_ptr<State>& state)
+    {
+        while (true)
+        {
+            PageRequest request;
+            {
+                std::lock_guard<std::mutex> lock(state->lock);
+                if (state->stop || !state->pending)
+                {
+                    state->scheduled = false;
+                    return;
+                }
+                std::swap(request, state->request);
+                state->pending = false;
+                state->running = true;
+            }
+
+            // builder is alive while running is set, its destructor waits
+            PagePtr page = builder->build(request);
+            if (page && state->ready)
+                state->ready(page);
+            {
+                std::lock_guard<std::mutex> lock(state->lock);
+                state->running = false;
+            }
+            state->idle.notify_all();
+        }
+    }
+
+    PagePtr PageBuilder::build(const PageRequest& request)
+    {
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point time_start = Clock::now();
+        if (PagePtr page = scroll(request))
+            return page;
+
+        Frame& frame = this->frame_;
+        takeUpdates();
+        Clock::time_point time_take = Clock::now();
+
+        ColumnTablePtr data = frame.current;
+        if (!data)
+            return PagePtr();
+        SortKeys sort_keys = valid_sort_keys(*data, request.sort_keys);
+        if (sort_keys.empty())
+            return PagePtr();
+
+        // in ROI mode the rows of interest are read through the list, nothing is copied
+        RowSetPtr roi;
+        const RowSet* rows = nullptr;
+        if (request.roi_mode)
+        {
+            roi = validRows(request.roi, data->size());
+            rows = roi.get();
+        }
+        std::shared_ptr<Page> page = std::make_shared<Page>();
+        page->requested = request.requested;
+        page->data = data;
+        page->decimals = request.decimals;
+        page->filter_total = rows ? (int)rows->size() : (int)data->size();
+
+        // the filter narrows them down before sorting, the same rows as shown keep the shown list
+        RowSetPtr matched = filterRows(*data, rows, request.filter);
+        if (matched)
+        {
+            RowSetPtr shown = frame.last ? frame.last->rows : RowSetPtr();
+            roi = (shown && (*shown == *matched)) ? shown : matched;
+            rows = roi.get();
+        }
+        if (!frame.last || (roi != frame.last->rows))// other rows, the last permutation is of no use
+            frame.sort_valid = false;
+        page->rows = roi;
+        page->filter_matches = matched ? (int)matched->size() : -1;
+        if (frame.filter_failed)
+            page->filter_error = frame.filter.error();
+        Clock::time_point time_roi = Clock::now();
+
+        int new_size = rows ? (int)rows->size() : (int)data->size();
+        int visible_first = std::min(std::max(0, request.first), new_size);
+        int visible_count = std::min(std::max(0, request.count), new_size - visible_first);
+
+        // in SortVisibleRows mode only the visible ranks are ordered
+        int sorted_first = 0;
+        int sorted_last = new_size - 1;
+        if (request.visible_only)
+        {
+            sorted_first = visible_first;
+            sorted_last = visible_first + visible_count - 1;
+        }
+
+        // sort data, several sort keys are one packed key column
+        bool is_ascend = true;
+        const Column& sort_key = frame.sort_key.build(*data, sort_keys, is_ascend);
+        std::shared_ptr<std::vector<size_t> > permutation = this->index_pool_->acquire(new_size);
+        std::vector<size_t>& index = *permutation;
+
+        // the permutation of the last full sort of the same order is reused: only patches since then,
+        // the patched rows are re-sorted; a new snapshot, the rows whose key changed are merged back
+        static const std::vector<size_t> none;
+        const std::vector<size_t>& previous = (frame.last && frame.last->index) ? *frame.last->index : none;
+        size_t max_moved = new_size / 8;
+        bool full_sort = !request.visible_only;
+        bool reuse = full_sort && frame.sort_valid && (frame.sorted_by == sort_keys) && (previous.size() == (size_t)new_size);
+        bool sorted = false;
+        if (reuse && !rows && !frame.all_dirty && (frame.dirty_rows.size() <= max_moved))
+        {
+            index.assign(previous.begin(), previous.end());
+            if (frame.dirty_rows.size())
+            {
+                repair_by_column(sort_key, index, frame.dirty_mark, frame.dirty_rows, frame.merge, is_ascend);
+                frame.sort_stats.patched++;
+            }
+            else
+            {
+                frame.sort_stats.unchanged++;
+            }
+            sorted = true;
+        }
+        else if (reuse)
+        {
+            index.assign(previous.begin(), previous.end());
+            sorted = resort_by_column(sort_key, rows, frame.sorted_keys, index, frame.moved_mark,
+                frame.displaced, frame.merge, max_moved, is_ascend);
+            if (sorted && frame.displaced.empty())
+                frame.sort_stats.unchanged++;
+            else if (sorted)
+                frame.sort_stats.adaptive++;
+            else
+                frame.sort_stats.fallback++;
+        }
+        if (!sorted)
+        {
+            sort_by_column(sort_key, rows, index, is_ascend, !full_sort, sorted_first, sorted_last);
+            if (full_sort)
+                frame.sort_stats.full++;
+            else
+                frame.sort_stats.window++;
+        }
+        frame.all_dirty = false;
+        frame.sort_valid = full_sort;
+        if (full_sort)
+            keep_keys(sort_key, rows, frame.sorted_keys);
+        frame.sorted_by = sort_keys;
+        clearDirty();
+        Clock::time_point time_sort = Clock::now();
+
+        page->index = permutation;
+        page->size = new_size;
+        page->sorted_first = sorted_first;
+        page->sorted_last = sorted_last;
+        page->sort_stats = frame.sort_stats;
+
+        // the text of the viewport, the GUI thread only hands it to the view
+        format_rows(*page, visible_first, visible_count, nullptr);
+        if (request.fade_ms > 0)
+            track_changes(*page, frame.last.get(), request.fade_ms);
+        if (request.history)
+            sample_history(*page, *request.history, request.history_column);
+        Clock::time_point time_format = Clock::now();
+
+        page->take_ms = elapsed_ms(time_start, time_take);
+        page->roi_ms = elapsed_ms(time_take, time_roi);
+        page->sort_ms = elapsed_ms(time_roi, time_sort);
+        page->format_ms = elapsed_ms(time_sort, time_format);
+        frame.last = page;
+        frame.last_request = request;
+        return page;
+    }
+
+    PagePtr PageBuilder::scroll(const PageRequest& request)
+    {
+        Frame& frame = this->frame_;
+        const PagePtr& last = frame.last;
+        if (!last || (last->data != frame.current) || !this->data_.empty() || this->pending_batches_.load()
+            || !same_order(request, frame.last_request))
+            return PagePtr();
+
+        int first = std::min(std::max(0, request.first), last->size);
+        int count = std::min(std::max(0, request.count), last->size - first);
+        if (request.visible_only && (count > 0) && ((first < last->sorted_first) || (first + count - 1 > last->sorted_last)))
+            return PagePtr();// ranks out of the ordered window
+
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point time_start = Clock::now();
+        std::shared_ptr<Page> page = std::make_shared<Page>();
+        page->requested = request.requested;
+        page->data = last->data;
+        page->rows = last->rows;
+        page->index = last->index;
+        page->size = last->size;
+        page->sorted_first = last->sorted_first;
+        page->sorted_last = last->sorted_last;
+        page->filter_matches = last->filter_matches;
+        page->filter_total = last->filter_total;
+        page->filter_error = last->filter_error;
+        page->decimals = last->decimals;
+        frame.sort_stats.scrolled++;
+        page->sort_stats = frame.sort_stats;
+        format_rows(*page, first, count, last.get());
+        if (request.fade_ms > 0)
+            track_changes(*page, last.get(), request.fade_ms);
+        if (request.history)
+            sample_history(*page, *request.history, request.history_column);
+        page->format_ms = elapsed_ms(time_start, Clock::now());
+
+        frame.last = page;
+        frame.last_request = request;
+        return page;
+    }
+
+    void PageBuilder::takeUpdates()
+    {
+        // patches first: a snapshot published after this point is newer than all of them (SpreadSheet
+        // takes a sequence and publishes in one step, whatever the number of producers)
+        Frame& frame = this->frame_;
+        std::vector<RowPatchBatch> batches;
+        {
+            std::lock_guard<std::mutex> lock(this->patch_lock_);
+            batches = this->patches_.takeAll();
+            size_t rows = 0;
+            for (auto& batch : batches)
+                rows += batch.rows.size();
+            this->pending_rows_ -= rows;
+            this->pending_batches_ -= batches.size();
+            this->collapsed_rows_ = 0;
+        }
+        ColumnTablePtr fresh = this->data_.take();
+        if (fresh)
+        {
+            frame.current = fresh;
+            frame.spares.clear();// nothing in common with the new snapshot
+            frame.all_dirty = true;
+            clearDirty();
+        }
+        if (batches.empty() || !frame.current)
+            return;
+
+        std::sort(batches.begin(), batches.end(), [](const RowPatchBatch& l, const RowPatchBatch& r) {
+            return l.sequence < r.sequence;
+        });
+        for (auto& batch : batches)
+        {
+            if (batch.sequence < frame.current->sequence())
+                continue;// the snapshot already has it
+            writable();
+            frame.current->patch(batch.rows.data(), batch.rows.size());
+            frame.current->setSequence(batch.sequence);
+            addLag(batch.rows);
+            markDirty(batch.rows);
+        }
+    }
+
+    void PageBuilder::writable()
+    {
+        // the pages shown, the stats and the jobs read it on other threads, then the patches go elsewhere.
+        // use_count is a relaxed load, the acquire fence orders the reads of the last holder (done before
+        // its release of the count) before the writes
+        Frame& frame = this->frame_;
+        if (frame.current.use_count() <= 1)
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return;
+        }
+
+        // the snapshot of the page before the one on display is usually free again, it only lacks the rows
+        // patched since: a tick costs the patched rows and not the table size
+        for (size_t i = 0; i < frame.spares.size(); i++)
+        {
+            if (frame.spares[i].table.use_count() > 1)
+                continue;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            Spare spare = std::move(frame.spares[i]);
+            frame.spares.erase(frame.spares.begin() + i);
+            spare.table->copyRows(*frame.current, spare.lag);
+            spare.table->setSequence(frame.current->sequence());
+            frame.spares.push_back({ frame.current, std::vector<size_t>() });
+            frame.current = spare.table;
+            return;
+        }
+
+        ColumnTablePtr copy = this->table_pool_->acquire(frame.current->size());
+        *copy = *frame.current;
+        if (frame.spares.size() < max_spares)
+            frame.spares.push_back({ frame.current, std::vector<size_t>() });
+        frame.current = copy;
+    }
+
+    void PageBuilder::addLag(const std::vector<RowPatch>& rows)
+    {
+        Frame& frame = this->frame_;
+        size_t size = frame.current->size();
+        for (size_t i = 0; i < frame.spares.size();)
+        {
+            std::vector<size_t>& lag = frame.spares[i].lag;
+            for (auto& it : rows)
+            {
+                if (it.row >= 0 && (size_t)it.row < size)
+                    lag.push_back(it.row);
+            }
+            // catching up would cost as much as a copy
+            if (lag.size() > size / 4)
+                frame.spares.erase(frame.spares.begin() + i);
+            else
+                i++;
+        }
+    }
+
+    void PageBuilder::markDirty(const std::vector<RowPatch>& rows)
+    {
+        Frame& frame = this->frame_;
+        size_t size = frame.current->size();
+        if (frame.dirty_mark.size() != size)
+        {
+            frame.dirty_mark.assign(size, 0);
+            frame.dirty_rows.clear();
+        }
+        for (auto& it : rows)
+        {
+            if (it.row < 0 || (size_t)it.row >= size || frame.dirty_mark[it.row])
+                continue;
+            frame.dirty_mark[it.row] = 1;
+            frame.dirty_rows.push_back(it.row);
+        }
+    }
+
+    void PageBuilder::clearDirty()
+    {
+        Frame& frame = this->frame_;
+        for (auto& r : frame.dirty_rows)
+        {
+            if (r < frame.dirty_mark.size())
+                frame.dirty_mark[r] = 0;
+        }
+        frame.dirty_rows.clear();
+    }
+
+    RowSetPtr PageBuilder::validRows(const RowSetPtr& rows, size_t size)
+    {
+        Frame& frame = this->frame_;
+        if (!rows)
+            return std::make_shared<const RowSet>();
+        if ((rows == frame.checked_idxs) && (size == frame.checked_size))
+            return frame.valid_idxs;
+
+        frame.checked_idxs = rows;
+        frame.checked_size = size;
+        bool valid = std::all_of(rows->begin(), rows->end(), [size](int r) { return r >= 0 && (size_t)r < size; });
+        if (valid)
+        {
+            frame.valid_idxs = rows;
+        }
+        else
+        {
+            std::shared_ptr<RowSet> copy = std::make_shared<RowSet>();
+            std::copy_if(rows->begin(), rows->end(), std::back_inserter(*copy), [size](int r) { return r >= 0 && (size_t)r < size; });
+            frame.valid_idxs = copy;
+        }
+        return frame.valid_idxs;
+    }
+
+    RowSetPtr PageBuilder::filterRows(const ColumnTable& data, const RowSet* rows, const std::string& text)
+    {
+        Frame& frame = this->frame_;
+        if (text.empty())
+        {
+            frame.filter_text.clear();
+            frame.filter_failed = false;
+            return RowSetPtr();
+        }
+        if ((text != frame.filter_text) || (frame.filter.schema() != data.schema()))
+        {
+            frame.filter_text = text;
+            frame.filter_failed = !frame.filter.compile(text, data.schema());
+        }
+        if (frame.filter_failed)
+            return RowSetPtr();
+
+        std::shared_ptr<RowSet> matched = this->row_pool_->acquire(0);
+        frame.filter.select(data, rows, *matched);
+        return matched;
+    }
+}
@@ -0,0 +1,252 @@
+#ifndef PAGE_BUILDER_H
+#define PAGE_BUILDER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "buffer_pool.h"
+#include "column_table.h"
+#include "row_filter.h"
+#include "row_history.h"
+#include "snapshot_mailbox.h"
+#include "sort_key.h"
+#include "worker_pool.h"
+
+namespace tool
+{
+    // how often each ordering path of the page builder ran
+    typedef struct SortStats {
+        unsigned long long full = 0;// all rows sorted from scratch
+        unsigned long long window = 0;// only the visible ranks (SortVisibleRows)
+        unsigned long long unchanged = 0;// the previous permutation was still in order
+        unsigned long long patched = 0;// only the rows of UpdateRows re-sorted and merged
+        unsigned long long adaptive = 0;// rows of a new snapshot with changed keys re-sorted and merged
+        unsigned long long fallback = 0;// too many rows moved to repair, sorted from scratch (not in full)
+        unsigned long long scrolled = 0;// only the viewport moved, the permutation of the last page was kept
+    }SortStats;
+
+    // what the GUI wants to see, passed with every request
+    typedef struct PageRequest {
+        std::chrono::steady_clock::time_point requested;
+        SortKeys sort_keys;
+        bool visible_only = false;// only the ranks of first to count are ordered (SortVisibleRows)
+        int first = 0;// the rows of the viewport and a band around it, they are formatted
+        int count = 0;
+        bool roi_mode = false;
+        RowSetPtr roi;// rows of interest in ROI mode, rows out of the snapshot are skipped
+        std::string filter;// RowFilter expression, empty for none
+        std::vector<int> decimals;// per column, of floating values, default_decimals if missing or negative
+        int fade_ms = 0;// changed cells stay highlighted this long, 0 does not look for changes
+        RowHistoryPtr history;// the rows of the viewport get their last values of history_column, null for none
+        int history_column = 1;
+    }PageRequest;
+
+    using IndexPtr = std::shared_ptr<const std::vector<size_t> >;
+
+    // decimals of floating columns without setColumnPrecision
+    const int default_decimals = 3;
+
+    // text of a number cell of the viewport, written on the builder. a string or a number longer than
+    // text is not held, it is read from the snapshot when needed
+    typedef struct CellText {
+        char text[30];
+        unsigned char size = 0;
+        bool held = false;
+    }CellText;
+
+    // one frame ready to show: the snapshot, its rows in display order and the text of the viewport.
+    // built off the GUI thread, never changed afterwards
+    typedef struct Page {
+        ColumnTablePtr data;
+        RowSetPtr rows;// the rows of interest matching the filter, null for all rows of data
+        IndexPtr index;// display row -> position in rows (or data)
+        int size = 0;// rows on display
+        int sorted_first = 0;// ranks of index in order, the others show "..."
+        int sorted_last = -1;
+
+        // the cells of the display rows [first, first + count), count rows of columns
+        int first = 0;
+        int count = 0;
+        int columns = 0;
+        std::vector<CellText> cells;
+        std::vector<int> decimals;// of the request
+
+        // changes of the cells, in the order of cells, with fade_ms of the request: the time of the last
+        // change seen (change_clock_ms, 0 for none) and one bit per cell changed less than fade_ms ago
+        std::vector<uint32_t> change_ms;
+        std::vector<uint64_t> changed;
+        uint32_t last_change_ms = 0;
+
+        // the history column after the columns of data (PageRequest::history): history_depth values per row
+        // of the cells, oldest first, history_sizes of them set. 0 history_column for no history column
+        int history_column = 0;
+        int history_depth = 0;
+        std::vector<float> history;
+        std::vector<uint16_t> history_sizes;
+
+        int filter_matches = -1;// -1 without filter
+        int filter_total = 0;// rows before the filter
+        std::string filter_error;// the filter does not compile against the schema of data
+        SortStats sort_stats;// since the builder started
+
+        // stages on the builder, in milliseconds
+        std::chrono::steady_clock::time_point requested;// of the request it was built for
+        double take_ms = 0.0;
+        double roi_ms = 0.0;
+        double sort_ms = 0.0;
+        double format_ms = 0.0;
+    }Page;
+
+    using PagePtr = std::shared_ptr<const Page>;
+
+    // decimals of column, see PageRequest::decimals
+    int column_decimals(const std::vector<int>& decimals, int column);
+
+    // milliseconds of the steady clock since the first call, plus one (0 is no time)
+    uint32_t change_clock_ms();
+
+    // the full stable sort of rows (all rows of table if null) by several columns, for the jobs.
+    // keys are valid_sort_keys of table
+    void sort_by_keys(const ColumnTable& table, const SortKeys& keys, const RowSet* rows, std::vector<size_t>& index);
+
+    // the update pipeline of a SpreadSheet off the GUI thread: takes the snapshots and patches of the
+    // producers, selects the rows of interest, filters, sorts (reusing the previous permutation) and
+    // formats the viewport, as tasks of group one at a time. a request replaces the one not started yet,
+    // every page goes to ready. when only the viewport moved since the last page (no update waiting, the
+    // same order and rows) its permutation is kept and only the rows scrolled in are formatted. thread safe
+    class PageBuilder
+    {
+    public:
+        // called on a pool thread with every page
+        using Ready = std::function<void(const PagePtr& page)>;
+
+        PageBuilder(const WorkerPool::GroupPtr& group, const std::shared_ptr<BufferPool<ColumnTable> >& table_pool, Ready ready);
+        ~PageBuilder();// waits for the running build, a queued task does nothing
+
+        PageBuilder(const PageBuilder&) = delete;
+        PageBuilder& operator=(const PageBuilder&) = delete;
+
+        // producers: the latest snapshot and the patches since, return true if the consumer has to be
+        // woken (see SnapshotMailbox::publish and BatchQueue::push). a publish that replaces a snapshot
+        // not taken yet counts as dropped. calls must come in the order of the sequences, several
+        // producers serialise them
+        bool publish(const ColumnTablePtr& table);
+        bool pushPatches(RowPatchBatch&& batch);
+        unsigned long long dropped() const { return dropped_.load(); }
+        size_t pendingBatches() const { return pending_batches_.load(); }
+        bool pendingSnapshot() const { return !data_.empty(); }
+
+        // build a page for request
+        void request(const PageRequest& request);
+
+    private:
+        // an older version of the current snapshot, it differs from it only in the lag rows
+        typedef struct Spare {
+            ColumnTablePtr table;
+            std::vector<size_t> lag;// may repeat rows
+        }Spare;
+
+        // worker side, touched by one task at a time
+        typedef struct Frame {
+            ColumnTablePtr current;// snapshot with the patches written
+            std::vector<Spare> spares;// versions of current before the last patches, at most max_spares
+            PagePtr last;// last page built, its permutation is repaired for the next one
+            PageRequest last_request;// the request of last
+
+            // rows patched since the last sort, dirty_mark has one byte per row
+            std::vector<size_t> dirty_rows;
+            std::vector<unsigned char> dirty_mark;
+            bool all_dirty = false;// a new snapshot arrived, any row may have moved
+
+            // state of the last full sort, the permutation is repaired while it is valid
+            bool sort_valid = false;
+            SortKeys sorted_by;
+            Column sorted_keys;// keys of the last full sort, by row
+            CompositeKey sort_key;
+            SortStats sort_stats;
+
+            // ROI list checked against the snapshot size, the same list is kept while it is unchanged
+            RowSetPtr checked_idxs;
+            RowSetPtr valid_idxs;
+            size_t checked_size = 0;
+
+            // compiled again when the text or the schema changes
+            RowFilter filter;
+            std::string filter_text;
+            bool filter_failed = false;
+
+            // scratch buffers kept between frames
+
+            std::vector<size_t> merge;
+            std::vector<size_t> displaced;
+            std::vector<unsigned char> moved_mark;
+        }Frame;
+
+        // shared with the queued task, it may run after the builder is gone
+        typedef struct State {
+            Ready ready;
+            std::mutex lock;
+            std::condition_variable idle;// the destructor: running got false
+            bool stop = false;
+            bool scheduled = false;// a task is queued or running
+            bool running = false;
+            bool pending = false;
+            PageRequest request;
+        }State;
+
+        static void run(PageBuilder* builder, const std::shared_ptr<State>& state);
+        PagePtr build(const PageRequest& request);
+
+        // the last page with the viewport of request, null if more than the viewport changed
+        PagePtr scroll(const PageRequest& request);
+
+        // take the pending patches and the latest snapshot, the snapshot replaces current,
+        // patches older than current are dropped, newer ones are written into it
+        void takeUpdates();
+
+        // make current safe to write. if a page or a job still holds it, a spare no one holds gets the
+        // rows it lags behind and becomes current (the old one a spare), only without one it is copied
+        void writable();
+
+        // the rows the patches wrote into current, spares lagging behind too many of them are dropped
+        void addLag(const std::vector<RowPatch>& rows);
+        void markDirty(const std::vector<RowPatch>& rows);
+        void clearDirty();
+
+        // the queued patches as one batch, a row once with its newest value, those of batches older than
+        // sequence dropped. runs on a producer, so that the queue of a sheet no one takes from stays
+        // within the size of the table. with grown only once the queue has as many new rows as the last
+        // merge kept, a producer spends time on the rows it queues and not on the table. another
+        // producer at it already skips it
+        void collapsePatches(unsigned long long sequence, bool grown);
+
+        // rows in range of a snapshot of size rows, the same list if all are
+        RowSetPtr validRows(const RowSetPtr& rows, size_t size);
+
+        // the rows (of interest, all if null) of data matching text, null without filter or if it does not compile
+        RowSetPtr filterRows(const ColumnTable& data, const RowSet* rows, const std::string& text);
+
+        WorkerPool::GroupPtr group_;
+        std::shared_ptr<BufferPool<ColumnTable> > table_pool_;// copies of snapshots to patch
+        std::shared_ptr<BufferPool<RowSet> > row_pool_;// filter results
+        std::shared_ptr<BufferPool<std::vector<size_t> > > index_pool_;// permutations
+
+        SnapshotMailbox<ColumnTable> data_;// latest snapshot from Update, not taken yet
+        BatchQueue<RowPatchBatch> patches_;// patches, written into the snapshot by takeUpdates
+        std::atomic<unsigned long long> dropped_{ 0 };
+        std::atomic<size_t> pending_batches_{ 0 };
+        std::atomic<size_t> pending_rows_{ 0 };
+        size_t collapsed_rows_ = 0;// of the last collapse, the next one waits for as many new rows
+        std::mutex patch_lock_;// the take of takeUpdates and collapsePatches, guards collapsed_rows_
+        Frame frame_;
+        std::shared_ptr<State> state_;
+    };
+}
+
+#endif // PAGE_BUILDER_H
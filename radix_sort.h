@@ -0,0 +1,155 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "worker_pool.h"
+
+namespace tool
+{
+    // run f(t) for t in [0, threads) on the shared WorkerPool, the caller runs the parts no worker took
+    template <typename F>
+    void parallel_for(unsigned threads, F f)
+    {
+        if (threads <= 1)
+        {
+            f(0u);
+            return;
+        }
+        WorkerPool::shared().parallel(threads, std::function<void(unsigned)>(std::ref(f)));
+    }
+
+    // unsigned keys with the order of the values, -0.0 is the same key as 0.0
+    inline uint32_t radix_key(int32_t v)
+    {
+        return (uint32_t)v ^ 0x80000000u;
+    }
+
+    inline uint64_t radix_key(int64_t v)
+    {
+        return (uint64_t)v ^ 0x8000000000000000ull;
+    }
+
+    inline uint32_t radix_key(float v)
+    {
+        uint32_t bits = 0;
+        if (v != 0.0f)
+            memcpy(&bits, &v, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+    }
+
+    inline uint64_t radix_key(double v)
+    {
+        uint64_t bits = 0;
+        if (v != 0.0)
+            memcpy(&bits, &v, sizeof(bits));
+        return (bits & 0x8000000000000000ull) ? ~bits : (bits | 0x8000000000000000ull);
+    }
+
+    template <typename T>
+    struct is_radix_sortable : std::integral_constant<bool,
+        std::is_same<T, int32_t>::value || std::is_same<T, int64_t>::value ||
+        std::is_same<T, float>::value || std::is_same<T, double>::value> {};
+
+    // below this size the comparison sort is as fast
+    const size_t radix_min_size = 2048;
+    // rows per thread worth starting a thread for
+    const size_t radix_rows_per_thread = 1 << 16;
+
+    template <typename Key>
+    struct RadixItem
+    {
+        Key key;
+        uint32_t index;
+    };
+
+    // stable LSD radix sort over (key, index) pairs, 8 bits per pass, multi-threaded for large inputs.
+    // idx gets the same permutation as sort_data: equal values keep their index order and the
+    // descending order is the reverse of the ascending one (the input is read backwards with inverted keys)
+    template <typename Container>
+    void radix_sort_indexes(const Container& v, std::vector<size_t>& idx, bool is_ascend = true)
+    {
+        using Key = decltype(radix_key(v[0]));
+        using Item = RadixItem<Key>;
+        const size_t size = idx.size();
+        const unsigned passes = sizeof(Key);
+
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = (unsigned)std::max<size_t>(1, std::min<size_t>(threads, size / radix_rows_per_thread));
+        auto chunk_begin = [size, threads](unsigned t) { return size * t / threads; };
+
+        // kept per thread, sorting the next frame does not allocate
+        static thread_local std::vector<Item> buffer_a;
+        static thread_local std::vector<Item> buffer_b;
+        buffer_a.resize(size);
+        buffer_b.resize(size);
+        Item* src = buffer_a.data();
+        Item* dst = buffer_b.data();
+
+        const Key flip = is_ascend ? Key(0) : ~Key(0);
+        parallel_for(threads, [&](unsigned t) {
+            for (size_t i = chunk_begin(t), e = chunk_begin(t + 1); i < e; i++)
+            {
+                size_t pos = is_ascend ? i : size - 1 - i;
+                src[i].key = radix_key(v[pos]) ^ flip;
+                src[i].index = (uint32_t)pos;
+            }
+        });
+
+        std::vector<size_t> counts(threads * 256);
+        for (unsigned pass = 0; pass < passes; pass++)
+        {
+            const unsigned shift = pass * 8;
+            parallel_for(threads, [&](unsigned t) {
+                size_t* count = &counts[t * 256];
+                std::fill(count, count + 256, 0);
+                for (size_t i = chunk_begin(t), e = chunk_begin(t + 1); i < e; i++)
+                    count[(src[i].key >> shift) & 0xFF]++;
+            });
+
+            // every key has the same digit, nothing to move
+            bool skip = false;
+            for (unsigned d = 0; d < 256 && !skip; d++)
+            {
+                size_t total = 0;
+                for (unsigned t = 0; t < threads; t++)
+                    total += counts[t * 256 + d];
+                skip = (total == size);
+            }
+            if (skip)
+                continue;
+
+            // start of each (digit, thread) block, digits first so that the order stays stable
+            size_t sum = 0;
+            for (unsigned d = 0; d < 256; d++)
+            {
+                for (unsigned t = 0; t < threads; t++)
+                {
+                    size_t c = counts[t * 256 + d];
+                    counts[t * 256 + d] = sum;
+                    sum += c;
+                }
+            }
+
+            parallel_for(threads, [&](unsigned t) {
+                size_t* offset = &counts[t * 256];
+                for (size_t i = chunk_begin(t), e = chunk_begin(t + 1); i < e; i++)
+                    dst[offset[(src[i].key >> shift) & 0xFF]++] = src[i];
+            });
+            std::swap(src, dst);
+        }
+
+        parallel_for(threads, [&](unsigned t) {
+            for (size_t i = chunk_begin(t), e = chunk_begin(t + 1); i < e; i++)
+                idx[i] = src[i].index;
+        });
+        return;
+    }
+}
+
+#endif // RADIX_SORT_H
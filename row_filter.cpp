@@ -0,0 +1,725 @@
+#include "row_filter.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ROW_FILTER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// the SIMD scans are built for their instruction set only, they run after simd_supported checked the cpu
+#if defined(ROW_FILTER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+namespace tool
+{
+    SimdLevel simd_supported()
+    {
+#if !defined(ROW_FILTER_X86)
+        return SimdLevel::Scalar;
+#elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int max_leaf = info[0];
+        __cpuid(info, 1);
+        bool sse2 = (info[3] & (1 << 26)) != 0;
+        bool os_saves_ymm = ((info[2] & (1 << 27)) != 0) && ((info[2] & (1 << 28)) != 0) && ((_xgetbv(0) & 6) == 6);
+        bool avx2 = false;
+        if ((max_leaf >= 7) && os_saves_ymm)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+        return avx2 ? SimdLevel::AVX2 : (sse2 ? SimdLevel::SSE2 : SimdLevel::Scalar);
+#else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2"))
+            return SimdLevel::SSE2;
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    namespace
+    {
+        // bit j of byte i is row 8 * i + j, the bits past size stay 0
+        template <typename T, typename Test>
+        void scan_scalar(const T* values, size_t first, size_t size, uint8_t* bits, Test test)
+        {
+            for (size_t i = first; i < size; i += 8)
+            {
+                size_t end = std::min(size, i + 8);
+                unsigned byte = 0;
+                for (size_t j = i; j < end; j++)
+                    byte |= (unsigned)test(values[j]) << (j - i);
+                bits[i >> 3] = (uint8_t)byte;
+            }
+        }
+
+        // lo <= v <= hi, negated if outside
+        template <typename T>
+        void scan_range_scalar(const T* values, size_t first, size_t size, T lo, T hi, bool outside, uint8_t* bits)
+        {
+            scan_scalar(values, first, size, bits, [lo, hi, outside](T v) { return ((v < lo) || (v > hi)) == outside; });
+        }
+
+        template <typename T>
+        void scan_compare_scalar(const T* values, size_t first, size_t size, int op, T c, uint8_t* bits)
+        {
+            switch (op)
+            {
+            case 0:
+                scan_scalar(values, first, size, bits, [c](T v) { return v < c; });
+                break;
+            case 1:
+                scan_scalar(values, first, size, bits, [c](T v) { return v <= c; });
+                break;
+            case 2:
+                scan_scalar(values, first, size, bits, [c](T v) { return v > c; });
+                break;
+            case 3:
+                scan_scalar(values, first, size, bits, [c](T v) { return v >= c; });
+                break;
+            case 4:
+                scan_scalar(values, first, size, bits, [c](T v) { return v == c; });
+                break;
+            default:
+                scan_scalar(values, first, size, bits, [c](T v) { return v != c; });
+                break;
+            }
+        }
+
+#if defined(ROW_FILTER_X86)
+        // the SIMD scans return the rows done, a multiple of 8, the scalar scan does the rest
+
+        TARGET_SSE2 size_t scan_range_sse2(const int32_t* values, size_t size, int32_t lo, int32_t hi, bool outside, uint8_t* bits)
+        {
+            const __m128i l = _mm_set1_epi32(lo);
+            const __m128i h = _mm_set1_epi32(hi);
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*)(values + i));
+                __m128i b = _mm_loadu_si128((const __m128i*)(values + i + 4));
+                __m128i out_a = _mm_or_si128(_mm_cmpgt_epi32(l, a), _mm_cmpgt_epi32(a, h));
+                __m128i out_b = _mm_or_si128(_mm_cmpgt_epi32(l, b), _mm_cmpgt_epi32(b, h));
+                int mask = _mm_movemask_ps(_mm_castsi128_ps(out_a)) | (_mm_movemask_ps(_mm_castsi128_ps(out_b)) << 4);
+                bits[i >> 3] = (uint8_t)(outside ? mask : ~mask);
+            }
+            return i;
+        }
+
+        TARGET_AVX2 size_t scan_range_avx2(const int32_t* values, size_t size, int32_t lo, int32_t hi, bool outside, uint8_t* bits)
+        {
+            const __m256i l = _mm256_set1_epi32(lo);
+            const __m256i h = _mm256_set1_epi32(hi);
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                __m256i v = _mm256_loadu_si256((const __m256i*)(values + i));
+                __m256i out = _mm256_or_si256(_mm256_cmpgt_epi32(l, v), _mm256_cmpgt_epi32(v, h));
+                int mask = _mm256_movemask_ps(_mm256_castsi256_ps(out));
+                bits[i >> 3] = (uint8_t)(outside ? mask : ~mask);
+            }
+            return i;
+        }
+
+        TARGET_AVX2 size_t scan_range_avx2(const int64_t* values, size_t size, int64_t lo, int64_t hi, bool outside, uint8_t* bits)
+        {
+            const __m256i l = _mm256_set1_epi64x(lo);
+            const __m256i h = _mm256_set1_epi64x(hi);
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                __m256i a = _mm256_loadu_si256((const __m256i*)(values + i));
+                __m256i b = _mm256_loadu_si256((const __m256i*)(values + i + 4));
+                __m256i out_a = _mm256_or_si256(_mm256_cmpgt_epi64(l, a), _mm256_cmpgt_epi64(a, h));
+                __m256i out_b = _mm256_or_si256(_mm256_cmpgt_epi64(l, b), _mm256_cmpgt_epi64(b, h));
+                int mask = _mm256_movemask_pd(_mm256_castsi256_pd(out_a)) | (_mm256_movemask_pd(_mm256_castsi256_pd(out_b)) << 4);
+                bits[i >> 3] = (uint8_t)(outside ? mask : ~mask);
+            }
+            return i;
+        }
+
+        // ordered compares, != is unordered: NaN is only != to anything, as in C++
+        template <int op>
+        TARGET_SSE2 __m128 compare_sse2(__m128 v, __m128 c)
+        {
+            if constexpr (0 == op) return _mm_cmplt_ps(v, c);
+            else if constexpr (1 == op) return _mm_cmple_ps(v, c);
+            else if constexpr (2 == op) return _mm_cmpgt_ps(v, c);
+            else if constexpr (3 == op) return _mm_cmpge_ps(v, c);
+            else if constexpr (4 == op) return _mm_cmpeq_ps(v, c);
+            else return _mm_cmpneq_ps(v, c);
+        }
+
+        template <int op>
+        TARGET_SSE2 __m128d compare_sse2(__m128d v, __m128d c)
+        {
+            if constexpr (0 == op) return _mm_cmplt_pd(v, c);
+            else if constexpr (1 == op) return _mm_cmple_pd(v, c);
+            else if constexpr (2 == op) return _mm_cmpgt_pd(v, c);
+            else if constexpr (3 == op) return _mm_cmpge_pd(v, c);
+            else if constexpr (4 == op) return _mm_cmpeq_pd(v, c);
+            else return _mm_cmpneq_pd(v, c);
+        }
+
+        constexpr int avx_predicate(int op)
+        {
+            return (0 == op) ? _CMP_LT_OQ : (1 == op) ? _CMP_LE_OQ : (2 == op) ? _CMP_GT_OQ :
+                (3 == op) ? _CMP_GE_OQ : (4 == op) ? _CMP_EQ_OQ : _CMP_NEQ_UQ;
+        }
+
+        template <int op>
+        TARGET_SSE2 size_t scan_compare_sse2(const float* values, size_t size, float c, uint8_t* bits)
+        {
+            const __m128 cv = _mm_set1_ps(c);
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                int mask = _mm_movemask_ps(compare_sse2<op>(_mm_loadu_ps(values + i), cv))
+                    | (_mm_movemask_ps(compare_sse2<op>(_mm_loadu_ps(values + i + 4), cv)) << 4);
+                bits[i >> 3] = (uint8_t)mask;
+            }
+            return i;
+        }
+
+        template <int op>
+        TARGET_SSE2 size_t scan_compare_sse2(const double* values, size_t size, double c, uint8_t* bits)
+        {
+            const __m128d cv = _mm_set1_pd(c);
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                int mask = 0;
+                for (int k = 0; k < 4; k++)
+                    mask |= _mm_movemask_pd(compare_sse2<op>(_mm_loadu_pd(values + i + 2 * k), cv)) << (2 * k);
+                bits[i >> 3] = (uint8_t)mask;
+            }
+            return i;
+        }
+
+        template <int op>
+        TARGET_AVX2 size_t scan_compare_avx2(const float* values, size_t size, float c, uint8_t* bits)
+        {
+            const __m256 cv = _mm256_set1_ps(c);
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+                bits[i >> 3] = (uint8_t)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(values + i), cv, avx_predicate(op)));
+            return i;
+        }
+
+        template <int op>
+        TARGET_AVX2 size_t scan_compare_avx2(const double* values, size_t size, double c, uint8_t* bits)
+        {
+            const __m256d cv = _mm256_set1_pd(c);
+            size_t i = 0;
+            for (; i + 8 <= size; i += 8)
+            {
+                int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + i), cv, avx_predicate(op)))
+                    | (_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + i + 4), cv, avx_predicate(op))) << 4);
+                bits[i >> 3] = (uint8_t)mask;
+            }
+            return i;
+        }
+
+        template <typename T>
+        size_t scan_compare_simd(const T* values, size_t size, int op, T c, SimdLevel level, uint8_t* bits)
+        {
+            if (SimdLevel::AVX2 == level)
+            {
+                switch (op)
+                {
+                case 0: return scan_compare_avx2<0>(values, size, c, bits);
+                case 1: return scan_compare_avx2<1>(values, size, c, bits);
+                case 2: return scan_compare_avx2<2>(values, size, c, bits);
+                case 3: return scan_compare_avx2<3>(values, size, c, bits);
+                case 4: return scan_compare_avx2<4>(values, size, c, bits);
+                default: return scan_compare_avx2<5>(values, size, c, bits);
+                }
+            }
+            if (SimdLevel::SSE2 == level)
+            {
+                switch (op)
+                {
+                case 0: return scan_compare_sse2<0>(values, size, c, bits);
+                case 1: return scan_compare_sse2<1>(values, size, c, bits);
+                case 2: return scan_compare_sse2<2>(values, size, c, bits);
+                case 3: return scan_compare_sse2<3>(values, size, c, bits);
+                case 4: return scan_compare_sse2<4>(values, size, c, bits);
+                default: return scan_compare_sse2<5>(values, size, c, bits);
+                }
+            }
+            return 0;
+        }
+
+        size_t scan_range_simd(const int32_t* values, size_t size, int32_t lo, int32_t hi, bool outside, SimdLevel level, uint8_t* bits)
+        {
+            if (SimdLevel::AVX2 == level)
+                return scan_range_avx2(values, size, lo, hi, outside, bits);
+            if (SimdLevel::SSE2 == level)
+                return scan_range_sse2(values, size, lo, hi, outside, bits);
+            return 0;
+        }
+
+        size_t scan_range_simd(const int64_t* values, size_t size, int64_t lo, int64_t hi, bool outside, SimdLevel level, uint8_t* bits)
+        {
+            if (SimdLevel::AVX2 == level)
+                return scan_range_avx2(values, size, lo, hi, outside, bits);
+            return 0;// no 64 bit compare in SSE2
+        }
+#else
+        template <typename T>
+        size_t scan_compare_simd(const T*, size_t, int, T, SimdLevel, uint8_t*)
+        {
+            return 0;
+        }
+
+        template <typename T>
+        size_t scan_range_simd(const T*, size_t, T, T, bool, SimdLevel, uint8_t*)
+        {
+            return 0;
+        }
+#endif
+
+        // v op c of an integer column as lo <= v <= hi, c may have decimals or be out of the type range
+        template <typename T>
+        void integer_range(int op, double c, int64_t& lo, int64_t& hi, bool& outside)
+        {
+            const double min = (double)std::numeric_limits<T>::min();
+            const double max = (double)std::numeric_limits<T>::max();
+            double l = min;
+            double h = max;
+            outside = false;
+            switch (op)
+            {
+            case 0: h = std::ceil(c) - 1; break;
+            case 1: h = std::floor(c); break;
+            case 2: l = std::floor(c) + 1; break;
+            case 3: l = std::ceil(c); break;
+            default:// == and !=
+                l = h = c;
+                if (std::floor(c) != c)
+                    l = max, h = min;// never equal
+                outside = (5 == op);
+                break;
+            }
+            if (std::isnan(c) || (l > h) || (l > max) || (h < min))
+            {
+                lo = 1;// empty
+                hi = 0;
+                return;
+            }
+            // the max of int64_t rounds up to 2^63 as a double, a bound there is clamped and not cast
+            lo = (l <= min) ? std::numeric_limits<T>::min() : (l >= max) ? std::numeric_limits<T>::max() : (int64_t)l;
+            hi = (h <= min) ? std::numeric_limits<T>::min() : (h >= max) ? std::numeric_limits<T>::max() : (int64_t)h;
+        }
+    }
+
+    // recursive descent over the expression text, the nodes are appended to the filter
+    struct RowFilter::Parser
+    {
+        RowFilter& filter;
+        const std::string& text;
+        size_t pos = 0;
+
+        Parser(RowFilter& filter, const std::string& text) : filter(filter), text(text) {}
+
+        bool fail(const std::string& message)
+        {
+            if (this->filter.error_.empty())
+                this->filter.error_ = message + " at " + std::to_string(this->pos + 1);
+            return false;
+        }
+
+        int failNode(const std::string& message)
+        {
+            fail(message);
+            return -1;
+        }
+
+        void skipSpace()
+        {
+            while (this->pos < this->text.size() && std::isspace((unsigned char)this->text[this->pos]))
+                this->pos++;
+        }
+
+        bool accept(const char* token)
+        {
+            skipSpace();
+            size_t len = strlen(token);
+            if (this->text.compare(this->pos, len, token) != 0)
+                return false;
+            this->pos += len;
+            return true;
+        }
+
+        bool atEnd()
+        {
+            skipSpace();
+            return this->pos >= this->text.size();
+        }
+
+        int add(Node::Kind kind, int left, int right)
+        {
+            Node node;
+            node.kind = kind;
+            node.left = left;
+            node.right = right;
+            this->filter.nodes_.push_back(node);
+            return (int)this->filter.nodes_.size() - 1;
+        }
+
+        // or := and ('||' and)*
+        int parseOr()
+        {
+            int left = parseAnd();
+            while (left >= 0 && accept("||"))
+            {
+                int right = parseAnd();
+                if (right < 0)
+                    return -1;
+                left = add(Node::Or, left, right);
+            }
+            return left;
+        }
+
+        // and := term ('&&' term)*
+        int parseAnd()
+        {
+            int left = parseTerm();
+            while (left >= 0 && accept("&&"))
+            {
+                int right = parseTerm();
+                if (right < 0)
+                    return -1;
+                left = add(Node::And, left, right);
+            }
+            return left;
+        }
+
+        // term := '(' or ')' | operand op operand, one operand a column and the other a number
+        int parseTerm()
+        {
+            if (accept("("))
+            {
+                int inner = parseOr();
+                if (inner < 0)
+                    return -1;
+                if (!accept(")"))
+                    return failNode("missing )");
+                return inner;
+            }
+
+            int column = -1;
+            double value = 0.0;
+            bool left_column = false;
+            if (!parseOperand(column, value, left_column))
+                return -1;
+
+            int op = parseOp();
+            if (op < 0)
+                return failNode("expected a comparison");
+
+            bool right_column = false;
+            if (!parseOperand(column, value, right_column))
+                return -1;
+            if (left_column == right_column)
+                return failNode("compare a column with a number");
+            if (right_column)// 5000 < v1 is v1 > 5000
+            {
+                const int mirrored[] = { 2, 3, 0, 1, 4, 5 };
+                op = mirrored[op];
+            }
+
+            Comparison comparison;
+            comparison.column = column;
+            comparison.op = (CompareOp)op;
+            comparison.value = value;
+            switch (this->filter.schema_[column].type)
+            {
+            case ColumnType::Int32:
+                integer_range<int32_t>(op, value, comparison.lo, comparison.hi, comparison.outside);
+                break;
+            case ColumnType::Int64:
+                integer_range<int64_t>(op, value, comparison.lo, comparison.hi, comparison.outside);
+                break;
+            case ColumnType::String:
+                return failNode("string column " + this->filter.schema_[column].name + " can not be compared");
+            default:
+                break;
+            }
+
+            int node = add(Node::Leaf, -1, -1);
+            this->filter.nodes_[node].comparison = comparison;
+            return node;
+        }
+
+        int parseOp()
+        {
+            // the two character operators first
+            const char* ops[] = { "<=", ">=", "==", "!=", "<", ">" };
+            const int codes[] = { 1, 3, 4, 5, 0, 2 };
+            for (int i = 0; i < 6; i++)
+            {
+                if (accept(ops[i]))
+                    return codes[i];
+            }
+            return -1;
+        }
+
+        // a column name or a number
+        bool parseOperand(int& column, double& value, bool& is_column)
+        {
+            skipSpace();
+            if (this->pos >= this->text.size())
+                return fail("unexpected end");
+
+            char c = this->text[this->pos];
+            if (std::isalpha((unsigned char)c) || '_' == c)
+            {
+                size_t begin = this->pos;
+                while (this->pos < this->text.size() && (std::isalnum((unsigned char)this->text[this->pos]) || '_' == this->text[this->pos]))
+                    this->pos++;
+                std::string name = this->text.substr(begin, this->pos - begin);
+                column = -1;
+                for (size_t i = 0; i < this->filter.schema_.size(); i++)
+                {
+                    if (this->filter.schema_[i].name == name)
+                        column = (int)i;
+                }
+                if (column < 0)
+                {
+                    this->pos = begin;
+                    return fail("unknown column " + name);
+                }
+                is_column = true;
+                return true;
+            }
+
+            // a decimal number with an optional sign and exponent, read the same whatever the C locale
+            // (QCoreApplication sets the one of the user, it may have a decimal comma)
+            const std::string& t = this->text;
+            size_t end = this->pos;
+            if (end < t.size() && ('+' == t[end] || '-' == t[end]))
+                end++;
+            size_t digits = 0;
+            for (; end < t.size() && std::isdigit((unsigned char)t[end]); end++)
+                digits++;
+            if (end < t.size() && '.' == t[end])
+            {
+                end++;
+                for (; end < t.size() && std::isdigit((unsigned char)t[end]); end++)
+                    digits++;
+            }
+            if (!digits)
+                return fail("expected a column or a number");
+            if (end < t.size() && ('e' == t[end] || 'E' == t[end]))
+            {
+                size_t exponent = end + 1;
+                if (exponent < t.size() && ('+' == t[exponent] || '-' == t[exponent]))
+                    exponent++;
+                if (exponent < t.size() && std::isdigit((unsigned char)t[exponent]))
+                {
+                    end = exponent;
+                    while (end < t.size() && std::isdigit((unsigned char)t[end]))
+                        end++;
+                }
+            }
+
+            // from_chars takes no plus sign
+            const char* first = t.data() + this->pos + (('+' == t[this->pos]) ? 1 : 0);
+            std::from_chars_result result = std::from_chars(first, t.data() + end, value);
+            if (result.ec == std::errc::invalid_argument || result.ptr != t.data() + end)
+                return fail("expected a column or a number");
+            if (result.ec == std::errc::result_out_of_range)
+                return fail("number out of range");
+            this->pos = end;
+            is_column = false;
+            return true;
+        }
+    };
+
+    RowFilter::RowFilter()
+        : level_(simd_supported())
+    {
+    }
+
+    bool RowFilter::compile(const std::string& expression, const Schema& schema)
+    {
+        this->expression_ = expression;
+        this->schema_ = schema;
+        this->error_.clear();
+        this->nodes_.clear();
+        this->root_ = -1;
+
+        Parser parser(*this, expression);
+        if (parser.atEnd())
+            return true;// matches every row
+
+        this->root_ = parser.parseOr();
+        if ((this->root_ >= 0) && !parser.atEnd())
+        {
+            parser.fail("unexpected text");
+            this->root_ = -1;
+        }
+        if (this->root_ < 0)
+        {
+            this->nodes_.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void RowFilter::setSimdLevel(SimdLevel level)
+    {
+        this->level_ = std::min(level, simd_supported());
+    }
+
+    void RowFilter::scan(const ColumnTable& table, const Comparison& comparison, uint8_t* bits)
+    {
+        const Column& column = table.column(comparison.column);
+        size_t size = table.size();
+        int op = (int)comparison.op;
+        switch (column.type())
+        {
+        case ColumnType::Int32:
+        {
+            const int32_t* values = column.values<int32_t>().data();
+            int32_t lo = (int32_t)comparison.lo;
+            int32_t hi = (int32_t)comparison.hi;
+            size_t done = scan_range_simd(values, size, lo, hi, comparison.outside, this->level_, bits);
+            scan_range_scalar(values, done, size, lo, hi, comparison.outside, bits);
+            break;
+        }
+        case ColumnType::Int64:
+        {
+            const int64_t* values = column.values<int64_t>().data();
+            size_t done = scan_range_simd(values, size, comparison.lo, comparison.hi, comparison.outside, this->level_, bits);
+            scan_range_scalar(values, done, size, comparison.lo, comparison.hi, comparison.outside, bits);
+            break;
+        }
+        case ColumnType::Float:
+        {
+            // compared as float, the constant is rounded to the column type
+            const float* values = column.values<float>().data();
+            float c = (float)comparison.value;
+            size_t done = scan_compare_simd(values, size, op, c, this->level_, bits);
+            scan_compare_scalar(values, done, size, op, c, bits);
+            break;
+        }
+        case ColumnType::Double:
+        {
+            const double* values = column.values<double>().data();
+            size_t done = scan_compare_simd(values, size, op, comparison.value, this->level_, bits);
+            scan_compare_scalar(values, done, size, op, comparison.value, bits);
+            break;
+        }
+        default:
+            memset(bits, 0, (size + 7) / 8);
+            break;
+        }
+    }
+
+    void RowFilter::eval(const ColumnTable& table, int node, size_t depth, uint8_t* bits)
+    {
+        const Node& n = this->nodes_[node];
+        if (Node::Leaf == n.kind)
+        {
+            scan(table, n.comparison, bits);
+            return;
+        }
+
+        size_t bytes = (table.size() + 7) / 8;
+        if (this->scratch_.size() <= depth)
+            this->scratch_.resize(depth + 1);
+        this->scratch_[depth].resize(bytes);
+
+        eval(table, n.left, depth + 1, bits);
+        uint8_t* other = this->scratch_[depth].data();
+        eval(table, n.right, depth + 1, other);
+        if (Node::And == n.kind)
+        {
+            for (size_t i = 0; i < bytes; i++)
+                bits[i] &= other[i];
+        }
+        else
+        {
+            for (size_t i = 0; i < bytes; i++)
+                bits[i] |= other[i];
+        }
+    }
+
+    void RowFilter::select(const ColumnTable& table, const RowSet* rows, RowSet& out)
+    {
+        out.clear();
+        size_t size = table.size();
+        if (this->root_ < 0)// no predicate
+        {
+            if (rows)
+            {
+                out.assign(rows->begin(), rows->end());
+            }
+            else
+            {
+                out.resize(size);
+                for (size_t i = 0; i < size; i++)
+                    out[i] = (int)i;
+            }
+            return;
+        }
+
+        size_t bytes = (size + 7) / 8;
+        this->bits_.resize(bytes);
+        uint8_t* bits = this->bits_.data();
+        eval(table, this->root_, 0, bits);
+
+        if (rows)
+        {
+            for (int r : *rows)
+            {
+                if ((bits[r >> 3] >> (r & 7)) & 1)
+                    out.push_back(r);
+            }
+            return;
+        }
+
+        // whole words of no match are skipped, the others are written without branches
+        out.resize(size + 8);
+        int* dst = out.data();
+        size_t count = 0;
+        for (size_t i = 0; i < bytes; i += 8)
+        {
+            size_t n = std::min<size_t>(8, bytes - i);
+            uint64_t word = 0;
+            memcpy(&word, bits + i, n);
+            if (!word)
+                continue;
+            for (size_t j = i; j < i + n; j++)
+            {
+                unsigned byte = bits[j];
+                int row = (int)(j * 8);
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    dst[count] = row + bit;
+                    count += (byte >> bit) & 1;
+                }
+            }
+        }
+        out.resize(count);
+    }
+}
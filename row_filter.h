@@ -0,0 +1,94 @@
+#ifndef ROW_FILTER_H
+#define ROW_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "column_table.h"
+
+namespace tool
+{
+    // instruction sets of the column scans
+    enum class SimdLevel
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    // the best level of this cpu
+    SimdLevel simd_supported();
+
+    // row predicate like "v1 > 5000 && v3 < 0.5": a column compared with a number (< <= > >= == !=),
+    // combined with &&, || and parentheses, && binds first. numbers are decimal with a point, an
+    // optional sign and exponent, in any locale. the columns are named by the schema,
+    // string columns can not be compared. every comparison is one vectorised scan of its column
+    // into a bitmap of 8 rows per byte, the bitmaps are combined bytewise
+    class RowFilter
+    {
+    public:
+        RowFilter();
+
+        // parse expression for tables of schema, an empty expression matches every row.
+        // return false and set error() on a syntax error or an unknown column, the filter is empty then
+        bool compile(const std::string& expression, const Schema& schema);
+
+        const std::string& expression() const { return expression_; }
+        const Schema& schema() const { return schema_; }
+        const std::string& error() const { return error_; }
+        bool empty() const { return nodes_.empty(); }
+
+        // the matching rows of table in increasing order, with rows (in range) only the listed ones in their order.
+        // table has the compiled schema. not thread safe, the scratch bitmaps are kept
+        void select(const ColumnTable& table, const RowSet* rows, RowSet& out);
+
+        // scan with at most level, simd_supported() by default
+        void setSimdLevel(SimdLevel level);
+        SimdLevel simdLevel() const { return level_; }
+
+    private:
+        enum class CompareOp
+        {
+            Less,
+            LessEqual,
+            Greater,
+            GreaterEqual,
+            Equal,
+            NotEqual,
+        };
+
+        // column op value. integer columns test lo <= v <= hi instead, outside negates it
+        typedef struct Comparison {
+            int column = 0;
+            CompareOp op = CompareOp::Equal;
+            double value = 0.0;
+            int64_t lo = 0;
+            int64_t hi = 0;
+            bool outside = false;
+        }Comparison;
+
+        typedef struct Node {
+            enum Kind { Leaf, And, Or } kind = Leaf;
+            int left = -1;
+            int right = -1;
+            Comparison comparison;
+        }Node;
+
+        struct Parser;
+
+        void eval(const ColumnTable& table, int node, size_t depth, uint8_t* bits);
+        void scan(const ColumnTable& table, const Comparison& comparison, uint8_t* bits);
+
+        std::string expression_;
+        std::string error_;
+        Schema schema_;
+        std::vector<Node> nodes_;
+        int root_ = -1;
+        SimdLevel level_;
+
+        std::vector<uint8_t> bits_;
+        std::vector<std::vector<uint8_t> > scratch_;// one bitmap per tree depth
+    };
+}
+
+#endif // ROW_FILTER_H
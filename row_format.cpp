@@ -0,0 +1,56 @@
+#include "row_format.h"
+#include <charconv>
+
+namespace tool
+{
+    char* format_cell(char* first, char* last, const Column& column, size_t row, int precision)
+    {
+        std::to_chars_result result{ first, std::errc() };
+        switch (column.type())
+        {
+        case ColumnType::Int32:
+            result = std::to_chars(first, last, column.values<int32_t>()[row]);
+            break;
+        case ColumnType::Int64:
+            result = std::to_chars(first, last, column.values<int64_t>()[row]);
+            break;
+        case ColumnType::Float:
+            result = std::to_chars(first, last, column.values<float>()[row], std::chars_format::fixed, precision);
+            break;
+        case ColumnType::Double:
+            result = std::to_chars(first, last, column.values<double>()[row], std::chars_format::fixed, precision);
+            break;
+        case ColumnType::String:
+        default:
+            break;
+        }
+        if (result.ec != std::errc())
+            return first;
+        return result.ptr;
+    }
+
+    void append_cell(std::string& out, const Column& column, size_t row, int precision)
+    {
+        if (ColumnType::String == column.type())
+        {
+            out += column.values<std::string>()[row];
+            return;
+        }
+
+        char buffer[cell_text_max];
+        char* end = format_cell(buffer, buffer + sizeof(buffer), column, row, precision);
+        out.append(buffer, end - buffer);
+    }
+
+    void append_row(std::string& out, const ColumnTable& table, size_t row, char sep, char row_sep)
+    {
+        size_t columns = table.columnCount();
+        for (size_t c = 0; c < columns; c++)
+        {
+            if (c)
+                out += sep;
+            append_cell(out, table.column(c), row);
+        }
+        out += row_sep;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef ROW_FORMAT_H
+#define ROW_FORMAT_H
+
+#include <string>
+#include "column_table.h"
+
+namespace tool
+{
+    // longest text of a number cell: fixed notation of the largest double with 3 decimals
+    const size_t cell_text_max = 320;
+
+    // write the text of a number cell into [first, last), floating values with precision decimals.
+    // return the end of the text, first if it does not fit. string cells are not written
+    char* format_cell(char* first, char* last, const Column& column, size_t row, int precision = 3);
+
+    // append the text of a cell, any column type
+    void append_cell(std::string& out, const Column& column, size_t row, int precision = 3);
+
+    // append the cells of a row separated by sep, then the row separator
+    void append_row(std::string& out, const ColumnTable& table, size_t row, char sep = ' ', char row_sep = '\n');
+}
+
+#endif // ROW_FORMAT_H
@@ -0,0 +1,165 @@
+#include "row_history.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace tool
+{
+    namespace
+    {
+        uint32_t float_bits(float v)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            return bits;
+        }
+
+        float bits_float(uint32_t bits)
+        {
+            float v;
+            std::memcpy(&v, &bits, sizeof(v));
+            return v;
+        }
+
+        int16_t clip_step(int64_t step)
+        {
+            return (int16_t)std::min<int64_t>(std::max<int64_t>(step, std::numeric_limits<int16_t>::min()), std::numeric_limits<int16_t>::max());
+        }
+    }
+
+    RowHistory::RowHistory(size_t rows, int depth, bool compact)
+        : rows_(rows)
+        , depth_(std::min(std::max(depth, 1), max_depth))
+        , compact_(compact)
+    {
+        this->head_.assign(rows, 0);
+        this->size_.assign(rows, 0);
+        size_t slots = 3 * (size_t)this->depth_ * rows;
+        if (compact)
+        {
+            this->packed_.assign(slots, 0);
+            this->latest_.assign(3 * rows, 0);
+        }
+        else
+        {
+            this->values_.assign(slots, 0);
+        }
+    }
+
+    size_t RowHistory::memoryBytes() const
+    {
+        return this->head_.size() * sizeof(uint16_t) + this->size_.size() * sizeof(uint16_t)
+            + this->values_.size() * sizeof(uint32_t) + this->packed_.size() * sizeof(uint16_t) + this->latest_.size() * sizeof(uint32_t);
+    }
+
+    void RowHistory::append(const ColumnTable& table)
+    {
+        if (table.schema() != ColumnTable::legacySchema())
+            return;
+
+        const int32_t* idx = table.column(0).values<int32_t>().data();
+        const int32_t* v1 = table.column(1).values<int32_t>().data();
+        const int32_t* v2 = table.column(2).values<int32_t>().data();
+        const float* v3 = table.column(3).values<float>().data();
+        size_t count = table.size();
+
+        std::lock_guard<std::mutex> lock(this->lock_);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (idx[i] >= 0 && (size_t)idx[i] < this->rows_)
+                push((size_t)idx[i], v1[i], v2[i], v3[i]);
+        }
+    }
+
+    void RowHistory::append(const RowPatch* rows, size_t count)
+    {
+        std::lock_guard<std::mutex> lock(this->lock_);
+        for (size_t i = 0; i < count; i++)
+        {
+            const DataStruct& data = rows[i].data;
+            if (data.idx >= 0 && (size_t)data.idx < this->rows_)
+                push((size_t)data.idx, data.v1, data.v2, data.v3);
+        }
+    }
+
+    void RowHistory::push(size_t row, int32_t v1, int32_t v2, float v3)
+    {
+        int slot = this->head_[row];
+        this->head_[row] = (uint16_t)((slot + 1) % this->depth_);
+        if (this->size_[row] < this->depth_)
+            this->size_[row]++;
+
+        uint32_t bits[3] = { (uint32_t)v1, (uint32_t)v2, float_bits(v3) };
+        if (!this->compact_)
+        {
+            for (int c = 0; c < 3; c++)
+                this->values_[at(c, slot, row)] = bits[c];
+            return;
+        }
+
+        // the step from the newest value, the first value of a row has none
+        bool first = (1 == this->size_[row]);
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t& latest = this->latest_[(size_t)c * this->rows_ + row];
+            uint16_t step = 0;
+            if (!first)
+                step = (2 == c) ? (uint16_t)((bits[c] ^ latest) >> 16) : (uint16_t)clip_step((int64_t)(int32_t)bits[c] - (int32_t)latest);
+            this->packed_[at(c, slot, row)] = step;
+            latest = bits[c];
+        }
+    }
+
+    void RowHistory::read(const int* idxs, size_t count, int column, float* values, uint16_t* sizes) const
+    {
+        int c = std::min(std::max(column, 1), 3) - 1;
+        std::lock_guard<std::mutex> lock(this->lock_);
+        for (size_t i = 0; i < count; i++)
+        {
+            float* out = values + i * this->depth_;
+            sizes[i] = 0;
+            if (idxs[i] < 0 || (size_t)idxs[i] >= this->rows_)
+                continue;
+
+            size_t row = (size_t)idxs[i];
+            int size = this->size_[row];
+            int newest = (this->head_[row] + this->depth_ - 1) % this->depth_;
+            sizes[i] = (uint16_t)size;
+            if (!this->compact_)
+            {
+                for (int k = 0; k < size; k++)
+                {
+                    uint32_t bits = this->values_[at(c, (newest - k + this->depth_) % this->depth_, row)];
+                    out[size - 1 - k] = (2 == c) ? bits_float(bits) : (float)(int32_t)bits;
+                }
+                continue;
+            }
+
+            // from the newest value back, each slot holds the step from the value before it
+            uint32_t bits = this->latest_[(size_t)c * this->rows_ + row];
+            int64_t value = (int32_t)bits;
+            for (int k = 0; k < size; k++)
+            {
+                int slot = (newest - k + this->depth_) % this->depth_;
+                uint16_t step = this->packed_[at(c, slot, row)];
+                if (2 == c)
+                {
+                    out[size - 1 - k] = bits_float(bits);
+                    bits = (bits ^ ((uint32_t)step << 16)) & 0xffff0000u;
+                }
+                else
+                {
+                    out[size - 1 - k] = (float)value;
+                    value -= (int16_t)step;
+                }
+            }
+        }
+    }
+
+    void RowHistory::clear()
+    {
+        std::lock_guard<std::mutex> lock(this->lock_);
+        std::fill(this->head_.begin(), this->head_.end(), 0);
+        std::fill(this->size_.begin(), this->size_.end(), 0);
+    }
+}
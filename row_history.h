@@ -0,0 +1,72 @@
+#ifndef ROW_HISTORY_H
+#define ROW_HISTORY_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "column_table.h"
+
+namespace tool
+{
+    // the last depth values of v1, v2 and v3 of every row idx in [0, rows), in arrays allocated once:
+    // column by column, slot by slot, row by row, so that appending a frame writes each slot array
+    // front to back. every row has its own ring, a row missing from a frame does not move.
+    // compact keeps 16 bits per value: v1 and v2 as the step from the previous value of the row
+    // (a step beyond the int16 range is clipped, the older values shift by the rest), v3 as the top
+    // 16 bits of the XOR with the previous float (its sign, exponent and 7 mantissa bits), the newest
+    // values are kept whole. thread safe
+    class RowHistory
+    {
+    public:
+        static constexpr int max_depth = 1024;
+
+        // depth is clamped to [1, max_depth]
+        RowHistory(size_t rows, int depth, bool compact = false);
+
+        RowHistory(const RowHistory&) = delete;
+        RowHistory& operator=(const RowHistory&) = delete;
+
+        size_t rows() const { return rows_; }
+        int depth() const { return depth_; }
+        bool compact() const { return compact_; }
+
+        // bytes of all arrays, fixed at construction
+        size_t memoryBytes() const;
+
+        // one pass over table in the legacy layout (see ColumnTable::legacySchema), every row appends
+        // its values to the ring of its idx. other schemas and idx out of range are skipped
+        void append(const ColumnTable& table);
+
+        // the patched rows, by the idx of their data
+        void append(const RowPatch* rows, size_t count);
+
+        // the values of column (1 v1, 2 v2, 3 v3) of the listed idx, oldest first: depth() values per idx
+        // in values, sizes gets how many of them are set (0 for an idx out of range)
+        void read(const int* idxs, size_t count, int column, float* values, uint16_t* sizes) const;
+
+        void clear();
+
+    private:
+        // the slot of value column c (0 v1, 1 v2, 2 v3) of row at slot
+        size_t at(int c, int slot, size_t row) const { return ((size_t)c * this->depth_ + slot) * this->rows_ + row; }
+
+        // append the values of one row under lock_
+        void push(size_t row, int32_t v1, int32_t v2, float v3);
+
+        mutable std::mutex lock_;
+        size_t rows_;
+        int depth_;
+        bool compact_;
+
+        std::vector<uint16_t> head_;// next slot, by row
+        std::vector<uint16_t> size_;// values kept, by row
+        std::vector<uint32_t> values_;// full: 3 x depth x rows values, v3 as its bits
+        std::vector<uint16_t> packed_;// compact: 3 x depth x rows steps
+        std::vector<uint32_t> latest_;// compact: 3 x rows newest values, v3 as its bits
+    };
+
+    using RowHistoryPtr = std::shared_ptr<const RowHistory>;
+}
+
+#endif // ROW_HISTORY_H
@@ -0,0 +1,126 @@
+#ifndef SNAPSHOT_MAILBOX_H
+#define SNAPSHOT_MAILBOX_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace tool
+{
+    // single slot holding only the latest published snapshot.
+    // publish and take are one atomic exchange each, no lock is taken,
+    // any number of producers may publish, one consumer takes.
+    template <typename T>
+    class SnapshotMailbox
+    {
+    public:
+        using Ptr = std::shared_ptr<T>;
+
+        SnapshotMailbox() : slot_(nullptr) {}
+
+        ~SnapshotMailbox()
+        {
+            delete slot_.exchange(nullptr);
+        }
+
+        SnapshotMailbox(const SnapshotMailbox&) = delete;
+        SnapshotMailbox& operator=(const SnapshotMailbox&) = delete;
+
+        // replace the slot content, return true if the slot was empty (the consumer has to be woken),
+        // false if an unconsumed snapshot was dropped
+        bool publish(const Ptr& value)
+        {
+            Ptr* box = new Ptr(value);
+            Ptr* old = slot_.exchange(box, std::memory_order_acq_rel);
+            if (!old)
+                return true;
+
+            delete old;// released on the producer side
+            return false;
+        }
+
+        // take the latest snapshot, empty if nothing was published since the last take
+        Ptr take()
+        {
+            if (!slot_.load(std::memory_order_acquire))
+                return Ptr();
+
+            Ptr* box = slot_.exchange(nullptr, std::memory_order_acq_rel);
+            if (!box)
+                return Ptr();
+
+            Ptr value = std::move(*box);
+            delete box;
+            return value;
+        }
+
+        bool empty() const
+        {
+            return !slot_.load(std::memory_order_acquire);
+        }
+
+    private:
+        std::atomic<Ptr*> slot_;
+    };
+
+    // lock-free stack of batches, any number of producers push, one consumer takes them all
+    template <typename T>
+    class BatchQueue
+    {
+    public:
+        BatchQueue() : head_(nullptr) {}
+
+        ~BatchQueue()
+        {
+            takeAll();
+        }
+
+        BatchQueue(const BatchQueue&) = delete;
+        BatchQueue& operator=(const BatchQueue&) = delete;
+
+        // return true if the queue was empty (the consumer has to be woken)
+        bool push(T value)
+        {
+            Node* node = new Node(std::move(value));
+            Node* head = head_.load(std::memory_order_relaxed);
+            do {
+                node->next = head;
+            } while (!head_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+            return !head;
+        }
+
+        // everything pushed so far, oldest first
+        std::vector<T> takeAll()
+        {
+            std::vector<T> values;
+            Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+            while (node)
+            {
+                values.push_back(std::move(node->value));
+                Node* next = node->next;
+                delete node;
+                node = next;
+            }
+            std::reverse(values.begin(), values.end());
+            return values;
+        }
+
+        bool empty() const
+        {
+            return !head_.load(std::memory_order_acquire);
+        }
+
+    private:
+        struct Node
+        {
+            Node(T&& v) : value(std::move(v)), next(nullptr) {}
+            T value;
+            Node* next;
+        };
+
+        std::atomic<Node*> head_;
+    };
+}
+
+#endif // SNAPSHOT_MAILBOX_H
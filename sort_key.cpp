@@ -0,0 +1,174 @@
+#include "sort_key.h"
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include "radix_sort.h"
+
+namespace tool
+{
+    namespace
+    {
+        unsigned bits_of(uint64_t value)
+        {
+            unsigned bits = 0;
+            while (value)
+            {
+                bits++;
+                value >>= 1;
+            }
+            return bits;
+        }
+
+        uint64_t low_mask(unsigned bits)
+        {
+            return (bits >= 64) ? ~0ull : ((1ull << bits) - 1);
+        }
+    }
+
+    bool operator==(const SortKey& l, const SortKey& r)
+    {
+        return (l.column == r.column) && (l.ascend == r.ascend);
+    }
+
+    bool operator!=(const SortKey& l, const SortKey& r)
+    {
+        return !(l == r);
+    }
+
+    SortKeys valid_sort_keys(const ColumnTable& data, const SortKeys& keys)
+    {
+        SortKeys valid;
+        for (auto& it : keys)
+        {
+            if (it.column < 0 || it.column >= (int)data.columnCount())
+                continue;
+            bool used = std::any_of(valid.begin(), valid.end(), [&it](const SortKey& k) { return k.column == it.column; });
+            if (!used)
+                valid.push_back(it);
+        }
+        return valid;
+    }
+
+    const Column& CompositeKey::build(const ColumnTable& data, const SortKeys& keys, bool& ascend)
+    {
+        if (1 == keys.size())
+        {
+            ascend = keys[0].ascend;
+            return data.column(keys[0].column);
+        }
+
+        // the full widths do not fit, the numbers are taken from the smallest one of their column
+        const size_t size = data.size();
+        unsigned full_bits = 0;
+        for (auto& it : keys)
+            full_bits += std::visit([](const auto& values) -> unsigned {
+                using V = typename std::decay<decltype(values)>::type::value_type;
+                if constexpr (std::is_same<V, std::string>::value)
+                    return 32;
+                else
+                    return (unsigned)(8 * sizeof(radix_key(V())));
+            }, data.column(it.column).storage());
+        bool narrow = (full_bits > 64);
+
+        // from the lowest key up, each one goes above the bits packed so far
+        this->acc_.assign(size, 0);
+        unsigned acc_bits = 0;
+        for (size_t k = keys.size(); k-- > 0;)
+        {
+            unsigned part_bits = columnKeys(data, keys[k], this->part_);
+            if (narrow && size)
+            {
+                auto range = std::minmax_element(this->part_.begin(), this->part_.end());
+                uint64_t low = *range.first;
+                part_bits = bits_of(*range.second - low);
+                for (auto& it : this->part_)
+                    it -= low;
+            }
+            if (acc_bits + part_bits > 64)
+                acc_bits = rank(this->acc_);
+            if (acc_bits + part_bits > 64)
+                part_bits = rank(this->part_);
+            if (!part_bits)
+                continue;// one value only, no order to add
+
+            for (size_t r = 0; r < size; r++)
+                this->acc_[r] |= this->part_[r] << acc_bits;
+            acc_bits += part_bits;
+        }
+
+        // as int64 with the same order, the int64 sort paths take it
+        this->key_.resize(size);
+        std::vector<int64_t>& values = this->key_.values<int64_t>();
+        for (size_t r = 0; r < size; r++)
+            values[r] = (int64_t)(this->acc_[r] ^ 0x8000000000000000ull);
+        ascend = true;
+        return this->key_;
+    }
+
+    unsigned CompositeKey::columnKeys(const ColumnTable& data, const SortKey& key, std::vector<uint64_t>& out)
+    {
+        const Column& column = data.column(key.column);
+        out.resize(data.size());
+        unsigned bits = std::visit([&](const auto& values) -> unsigned {
+            using V = typename std::decay<decltype(values)>::type::value_type;
+            if constexpr (std::is_same<V, std::string>::value)
+            {
+                // strings have no fixed width number, their rank is one
+                this->index_.resize(values.size());
+                std::iota(this->index_.begin(), this->index_.end(), 0);
+                std::stable_sort(this->index_.begin(), this->index_.end(), [&values](size_t l, size_t r) { return values[l] < values[r]; });
+                uint64_t rank = 0;
+                for (size_t i = 0; i < this->index_.size(); i++)
+                {
+                    if (i && values[this->index_[i - 1]] < values[this->index_[i]])
+                        rank++;
+                    out[this->index_[i]] = rank;
+                }
+                return bits_of(rank);
+            }
+            else
+            {
+                for (size_t r = 0; r < values.size(); r++)
+                    out[r] = radix_key(values[r]);
+                return (unsigned)(8 * sizeof(radix_key(V())));
+            }
+        }, column.storage());
+
+        if (!key.ascend)
+        {
+            uint64_t mask = low_mask(bits);
+            for (auto& it : out)
+                it = ~it & mask;
+        }
+        return bits;
+    }
+
+    unsigned CompositeKey::rank(std::vector<uint64_t>& values)
+    {
+        // sorted through the int64 radix sort, equal values get the same rank
+        const size_t size = values.size();
+        std::vector<int64_t> keys(size);
+        for (size_t r = 0; r < size; r++)
+            keys[r] = (int64_t)(values[r] ^ 0x8000000000000000ull);
+        this->index_.resize(size);
+        if ((size >= radix_min_size) && (size < 0xFFFFFFFFull))
+        {
+            radix_sort_indexes(keys, this->index_);
+        }
+        else
+        {
+            std::iota(this->index_.begin(), this->index_.end(), 0);
+            std::stable_sort(this->index_.begin(), this->index_.end(), [&keys](size_t l, size_t r) { return keys[l] < keys[r]; });
+        }
+
+        uint64_t rank = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            if (i && keys[this->index_[i - 1]] != keys[this->index_[i]])
+                rank++;
+            values[this->index_[i]] = rank;
+        }
+        return bits_of(rank);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef SORT_KEY_H
+#define SORT_KEY_H
+
+#include <cstdint>
+#include <vector>
+#include "column_table.h"
+
+namespace tool
+{
+    // one column of a multi-column sort
+    typedef struct SortKey {
+        int column = 0;
+        bool ascend = true;
+    }SortKey;
+
+    // in priority order, the first key decides, the next ones break its ties
+    using SortKeys = std::vector<SortKey>;
+
+    bool operator==(const SortKey& l, const SortKey& r);
+    bool operator!=(const SortKey& l, const SortKey& r);
+
+    // the keys with a column of data, a column used twice keeps its first place
+    SortKeys valid_sort_keys(const ColumnTable& data, const SortKeys& keys);
+
+    // one key column for several sort keys, so a multi-column sort is the single-column sort of it.
+    // every key becomes an unsigned number with its order (inverted if descending), numbers are 32 bits
+    // (int32, float) or 64 bits (int64, double), strings their rank. the numbers are packed into one
+    // int64 per row, the first key highest. when they do not fit in 64 bits they are taken from the
+    // smallest number of their column, the bits of the range are enough; if that is still too wide the
+    // lower keys packed so far are replaced by their rank among the rows, which keeps their order in
+    // fewer bits. at full width the key of a row depends on that row alone, the re-sort of the next frame
+    // only moves the changed rows
+    class CompositeKey
+    {
+    public:
+        // the column to sort data by ascending (with ascend set) or descending. one key is its own column,
+        // several are packed into an Int64 column held by this. keys are valid_sort_keys, at least one
+        const Column& build(const ColumnTable& data, const SortKeys& keys, bool& ascend);
+
+    private:
+        // the ordered number of key for every row of data, its bit width
+        unsigned columnKeys(const ColumnTable& data, const SortKey& key, std::vector<uint64_t>& out);
+
+        // replace values by their dense rank, return the bits of the largest rank
+        unsigned rank(std::vector<uint64_t>& values);
+
+        Column key_ = Column(ColumnType::Int64);
+        std::vector<uint64_t> acc_;
+        std::vector<uint64_t> part_;
+        std::vector<size_t> index_;
+    };
+}
+
+#endif // SORT_KEY_H
@@ -9,16 +9,29 @@
 #include <qevent.h>
 #include <qclipboard.h>
 #include <qscrollbar.h>
-#include <QStandardItemModel>
 #include <QMessageBox>
 #include <QFileDialog>
 #include <qmenu.h>
 #include <qpointer.h>
-#include <queue>
+#include <QLabel>
+#include <QElapsedTimer>
+#include <QMimeData>
+#include <QApplication>
+#include <algorithm>
+#include <numeric>
+#include <variant>
 #include <mutex>
-#include <fstream>
+#include <atomic>
 
 #include "ui_spread_sheet.h"
+#include "table_model.h"
+#include "cell_delegate.h"
+#include "snapshot_mailbox.h"
+#include "export_job.h"
+#include "copy_job.h"
+#include "frame_log.h"
+#include "row_filter.h"
+#include "stats_model.h"
 
 #ifdef _MSC_VER
 
@@ -67,25 +80,91 @@ namespace
 
 namespace tool
 {
+    namespace
+    {
+        // selections up to this many cells are copied in the GUI thread, larger ones by a CopyJob
+        const size_t copy_sync_cells = 1 << 16;
+
+        // viewports formatted ahead above and below the visible one, scrolling within them needs no page
+        const int prefetch_viewports = 2;
+    }
+
     class SpreadSheet::Internal
     {
     public:
         Ui::SpreadSheet Ui;
-        std::queue<DatasPtr> data_;
-        std::mutex lock_;
-        std::vector<int> idxs_;// poi indexs
-        bool need_stop_;
-        DatasPtr current_;
+        std::mutex lock_;// guards idxs_ and roi_mode_
+        RowSetPtr idxs_;// poi indexs, shared with the producer, never written
+        std::shared_ptr<BufferPool<Datas> > pool_;// recycled Datas for producers
+        std::shared_ptr<BufferPool<ColumnTable> > table_pool_;// recycled tables for Update and copies of patched snapshots
+        std::atomic<unsigned long long> sequence_;// order of snapshots and patches
+
+        // a sequence is taken and its snapshot or patches handed to the builder (and the log) in one step:
+        // the builder sees them in sequence order, a patch never lands before the snapshot it follows
+        std::mutex publish_lock_;
+
+        // frame log of startRecording, swapped atomically, the producers record through their own reference
+        std::shared_ptr<FrameLogWriter> recorder_;
+
+        // setRowHistory, swapped atomically like recorder_, the builder reads it for the history column
+        std::shared_ptr<RowHistory> history_;
+        int history_column_ = 1;
+
+        std::unique_ptr<ExportJob> export_;// running or finished export, reset by onExportFinished
+        SnapshotMailbox<std::string> copied_;// text of copy_, put on the clipboard by onCopyReady
+        std::unique_ptr<CopyJob> copy_;// large selection formatted in the background, a new copy replaces it
+
+        // setFilter, passed to the page builder with every request. the label shows the last page
+        std::string filter_text_;
+        QString filter_error_;// of the last page, its filter does not compile against the schema
+        int filter_matches_ = -1;
+        int filter_total_ = -1;
+
+        // instrumentation, frame_stats_ is written by the GUI thread, the counters by the producers too
+        FrameStats frame_stats_;
+        std::atomic<unsigned long long> published_{ 0 };
+        std::atomic<unsigned long long> patch_batches_{ 0 };
+        std::chrono::steady_clock::time_point last_frame_;
+        double request_ms_ = 0.0;// GUI thread time of the last slotUpdate
+        QLabel* overlay_ = nullptr;// stats drawn over the table, see setStatsOverlay
+        QElapsedTimer overlay_timer_;
+
+        // render scheduling, tableUpdate only marks the view dirty, the timer runs slotUpdate
+        QTimer* frame_timer_ = nullptr;
+        QElapsedTimer frame_clock_;// since the start of the last slotUpdate
+        int max_fps_ = 60;
+        unsigned long long requests_ = 0;
+
+        // change highlight, the viewport is repainted while the tint of the last change fades
+        CellDelegate* delegate_ = nullptr;
+        QTimer* fade_timer_ = nullptr;
+
+        // tasks of this sheet on the shared pool, paused while the sheet can not be seen (updateWorkPriority)
+        WorkerPool::GroupPtr work_ = WorkerPool::shared().createGroup();
+        WorkPriority priority_ = WorkPriority::Visible;
+        QPointer<QWidget> watched_window_;// its state changes update priority_
+
+        // column stats footer, the rows of every frame are summed up on stats_worker_ (null when off),
+        // its results come back through stats_ready_
+        StatsModel* stats_model_ = nullptr;
+        SnapshotMailbox<const TableStats> stats_ready_;
+        int stats_bins_ = 0;
+        unsigned long long stats_sequence_ = 0;// last request, frames of the same rows are not summed again
+        RowSetPtr stats_rows_;
+
         bool need_reorder_;
         int order_column_;
         bool roi_mode_;
 
-        int visiable_first = 0;
-        int visiable_last = -1;
-        int rows_to_show = 200;
+        // takes the snapshots and patches, its pages come back through page_ready_
+        SnapshotMailbox<const Page> page_ready_;
+        std::unique_ptr<PageBuilder> builder_;
+        std::unique_ptr<ColumnStatsWorker> stats_worker_;// last member, stopped before the rest goes
 
         Internal(SpreadSheet* self):
-            need_stop_(false),
+            pool_(new BufferPool<Datas>()),
+            table_pool_(new BufferPool<ColumnTable>()),
+            sequence_(0),
             need_reorder_(false),
             roi_mode_(false),
             order_column_(0)
@@ -104,47 +183,23 @@ namespace tool
         , Internals(new SpreadSheet::Internal(this))
     {
         this->dataTable = this->Internals->Ui.tableView;
-        QStandardItemModel* tableModel = new QStandardItemModel(this);
+        TableModel* tableModel = new TableModel(this->column_, this);
 
-        QStringList title;
-        for (int i = 0; i < this->column_; i++)
-        {
-            QString col_str;
-            col_str = col_str.sprintf("col %d", i);
-            title.push_back(col_str);
-        }
-        tableModel->setHorizontalHeaderLabels(title);
         dataTable->horizontalHeader()->setMinimumHeight(25);
         dataTable->horizontalHeader()->setStyleSheet("QHeaderView::section {"
             "color: black;padding-left: 4px;border: 1px solid gray;}");//border: 1px solid #6c6c6c;
         dataTable->verticalHeader()->setStyleSheet("QHeaderView::section {"
             "color: black;padding-left: 4px;border: 1px solid gray;}");//border: 1px solid #6c6c6c;
 
-
-        for (int r = 0; r < row; ++r) {
-            for (int c = 0; c < column_; ++c) {
-                QStandardItem *item = NULL;
-
-                if (c == 0)
-                {
-                    QVariant v = r;
-                    item = new QStandardItem();
-                    item->setData(v, Qt::EditRole);
-                }
-                else
-                    item = new QStandardItem(QString("..."));// default is ...
-                tableModel->setItem(r, c, item);
-            }
-        }
-        this->Internals->visiable_first = -1;
-        this->Internals->visiable_last = -1;
-
         this->dataTable->setEditTriggers(QAbstractItemView::NoEditTriggers);// read only
         this->dataTable->setModel(tableModel);
+        this->Internals->delegate_ = new CellDelegate(tableModel, this->dataTable);// numbers painted from the page text
+        this->dataTable->setItemDelegate(this->Internals->delegate_);
         this->dataTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
 
         this->dataTable->horizontalHeader()->setSortIndicator(0, Qt::AscendingOrder);
         this->dataTable->horizontalHeader()->setSortIndicatorShown(true);
+        tableModel->setSortKeys(this->sort_keys_);
         this->dataTable->setContextMenuPolicy(Qt::CustomContextMenu);
         dataTable->setSortingEnabled(false);// disable default order
 
@@ -154,11 +209,17 @@ namespace tool
         this->action_select_all_ = new QAction(tr("Select All"), this);
         this->action_copy_ = new QAction(tr("Copy"), this);
         this->action_export_ = new QAction(tr("Export"), this);
+        this->action_stats_ = new QAction(tr("Show Stats"), this);
+        this->action_stats_->setCheckable(true);
+        this->action_footer_ = new QAction(tr("Show Column Stats"), this);
+        this->action_footer_->setCheckable(true);
 
         this->right_popup_menu_->addAction(action_select_col_);
         this->right_popup_menu_->addAction(action_select_all_);
         this->right_popup_menu_->addAction(action_copy_);
         this->right_popup_menu_->addAction(action_export_);
+        this->right_popup_menu_->addAction(action_stats_);
+        this->right_popup_menu_->addAction(action_footer_);
 
         // table range changed
         connect(this->dataTable, SIGNAL(customContextMenuRequested(const QPoint &)),
@@ -168,114 +229,495 @@ namespace tool
         connect(this->action_select_all_, SIGNAL(triggered()), this, SLOT(onActionSelectAll()));
         connect(this->action_copy_, SIGNAL(triggered()), this, SLOT(onActionCopy()));
         connect(this->action_export_, SIGNAL(triggered()), this, SLOT(onActionExport()));
-
-        connect(this, SIGNAL(tableUpdate()), this, SLOT(slotUpdate()));
+        connect(this->action_stats_, SIGNAL(toggled(bool)), this, SLOT(setStatsOverlay(bool)));
+        connect(this->action_footer_, SIGNAL(toggled(bool)), this, SLOT(setStatsFooter(bool)));
+
+        // every refresh request is merged into the next frame, at most max_fps_ frames a second
+        this->Internals->frame_timer_ = new QTimer(this);
+        this->Internals->frame_timer_->setSingleShot(true);
+        this->Internals->frame_timer_->setTimerType(Qt::PreciseTimer);
+        connect(this->Internals->frame_timer_, SIGNAL(timeout()), this, SLOT(slotUpdate()));
+        this->Internals->fade_timer_ = new QTimer(this);
+        this->Internals->fade_timer_->setInterval(33);
+        connect(this->Internals->fade_timer_, SIGNAL(timeout()), this, SLOT(onFadeTick()));
+        connect(this, SIGNAL(tableUpdate()), this, SLOT(scheduleUpdate()));
+        connect(this, SIGNAL(exportFinished(bool, QString)), this, SLOT(onExportFinished(bool, QString)));
+        connect(this->Internals->Ui.filterEdit, SIGNAL(returnPressed()), this, SLOT(onFilterEdited()));
+        connect(this, SIGNAL(statsReady()), this, SLOT(onStatsReady()));
+        connect(this, SIGNAL(copyReady()), this, SLOT(onCopyReady()));
+        connect(this, SIGNAL(pageReady()), this, SLOT(onPageReady()));
+
+        // sorting and formatting run on the pool, only the finished page comes to the GUI thread
+        this->Internals->builder_.reset(new PageBuilder(this->Internals->work_, this->Internals->table_pool_, [this](const PagePtr& page) {
+            // only the latest page is kept, the GUI thread is woken once
+            if (this->Internals->page_ready_.publish(page))
+                emit pageReady();
+        }));
+
+        // column stats footer, read only, its columns line up with the table's (the .ui gives it the same vertical scrollbar)
+        QTableView* statsView = this->Internals->Ui.statsView;
+        this->Internals->stats_model_ = new StatsModel(this);
+        statsView->setModel(this->Internals->stats_model_);
+        statsView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        statsView->horizontalHeader()->setVisible(false);
+        statsView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+        statsView->verticalHeader()->setStyleSheet("QHeaderView::section {"
+            "color: black;padding-left: 4px;border: 1px solid gray;}");
+        this->action_footer_->setChecked(true);// starts the stats thread
 
         // vertical scrollbar valuechanged
         QScrollBar *bar = this->dataTable->verticalScrollBar();
         connect((QWidget*)bar, SIGNAL(valueChanged(int)), this, SLOT(verticalScrollMoved(int)));
         connect(this->dataTable->horizontalHeader(), SIGNAL(sortIndicatorChanged(int, Qt::SortOrder)), this, SLOT(sortIndicatorChanged(int, Qt::SortOrder)));
-        refresh_task_.reset(new std::thread(std::bind(&SpreadSheet::updateThread, this)));
-
-        // init status: hide all items
-        this->dataTable->setUpdatesEnabled(false);
-        for (int r = row - 1; r >= 0; --r)
-            dataTable->setRowHidden(r, true);
-        this->dataTable->setUpdatesEnabled(true);
 
+        // paused until shown
+        updateWorkPriority();
     }
 
     SpreadSheet::~SpreadSheet()
     {
-        if (refresh_task_)
+        delete this->Internals;
+    }
+
+    void SpreadSheet::adjustRows(int rows)
+    {
+        if (rows == this->data_rows_)
+            return;
+
+        // the model only holds rows of real data, no items are allocated. one insert or remove of
+        // the difference, the view keeps no per-row state and only the visible rows are repainted
+        TableModel* tableModel = (TableModel*)this->dataTable->model();
+        tableModel->setRows(rows);
+        this->data_rows_ = rows;
+    }
+
+    void SpreadSheet::getVisiableRow(int& first, int& last)
+    {
+        first = this->Internals->Ui.tableView->rowAt(0);// visiable first row 
+        last = this->Internals->Ui.tableView->rowAt(this->Internals->Ui.tableView->viewport()->rect().bottom());// visiable last row
+    }
+
+    void SpreadSheet::Update(DatasPtr& data)
+    {
+        if (!data)
+            return;
+
+        // rows are turned into columns on the producer side, data can be reused after the call
+        ColumnTablePtr table = acquireTable(ColumnTable::legacySchema(), data->size());
+        table->assign(*data);
+        Update(table);
+    }
+
+    void SpreadSheet::Update(ColumnTablePtr& table)
+    {
+        if (!table)
+            return;
+        if (std::shared_ptr<RowHistory> history = std::atomic_load(&this->Internals->history_))
+            history->append(*table);
+
+        // only the latest snapshot is kept, the GUI thread is woken once when the mailbox gets filled,
+        // a queued signal if called from another thread
+        bool woken = false;
         {
-            this->Internals->need_stop_ = true;
-            refresh_task_->join();
-            refresh_task_.reset();
+            std::lock_guard<std::mutex> lock(this->Internals->publish_lock_);
+            table->setSequence(++this->Internals->sequence_);
+            this->Internals->published_++;
+            if (std::shared_ptr<FrameLogWriter> recorder = std::atomic_load(&this->Internals->recorder_))
+                recorder->addSnapshot(table);
+            woken = this->Internals->builder_->publish(table);
         }
+        if (woken)
+            emit tableUpdate();
+    }
+
+    void SpreadSheet::setSortMode(SortMode mode)
+    {
+        this->sort_mode_ = mode;
+        emit tableUpdate();
+    }
+
+    SpreadSheet::SortMode SpreadSheet::sortMode() const
+    {
+        return this->sort_mode_;
     }
 
-    void SpreadSheet::updateThread()
+    void SpreadSheet::setSortKeys(const SortKeys& keys)
     {
-        while (!this->Internals->need_stop_)
+        this->sort_keys_ = keys;
+
+        // the header arrow shows the first key, a click next to it flips that one
+        if (keys.size())
         {
-            std::this_thread::sleep_for(std::chrono::microseconds(20));
+            QHeaderView* header = this->dataTable->horizontalHeader();
+            header->blockSignals(true);
+            header->setSortIndicator(keys[0].column, keys[0].ascend ? Qt::AscendingOrder : Qt::DescendingOrder);
+            header->blockSignals(false);
+        }
+        TableModel* tableModel = (TableModel*)this->dataTable->model();
+        tableModel->setSortKeys(keys);
+        emit tableUpdate();
+    }
 
-            std::lock_guard<std::mutex> lock(this->Internals->lock_);
-            {
-                if (!this->Internals->data_.size())
-                    continue;
-                this->Internals->current_ = this->Internals->data_.front();
-                this->Internals->data_.pop();
-                while (this->Internals->data_.size() > 2)
-                    this->Internals->data_.pop();
-                emit tableUpdate();
-            }
+    SortKeys SpreadSheet::sortKeys() const
+    {
+        return this->sort_keys_;
+    }
+
+    void SpreadSheet::setColumnPrecision(int column, int decimals)
+    {
+        if (column < 0)
+            return;
+        if ((size_t)column >= this->precision_.size())
+            this->precision_.resize(column + 1, -1);
+        this->precision_[column] = std::max(-1, decimals);
+        emit tableUpdate();
+    }
+
+    int SpreadSheet::columnPrecision(int column) const
+    {
+        return column_decimals(this->precision_, column);
+    }
+
+    void SpreadSheet::setChangeHighlight(int fade_ms, const QColor& color)
+    {
+        this->Internals->delegate_->setChangeHighlight(fade_ms, color);
+        if (!this->Internals->delegate_->changeFade())
+            this->Internals->fade_timer_->stop();
+        this->dataTable->viewport()->update();
+        emit tableUpdate();
+    }
+
+    int SpreadSheet::changeHighlight() const
+    {
+        return this->Internals->delegate_->changeFade();
+    }
+
+    void SpreadSheet::setRowHistory(int depth, int rows, bool compact, int column)
+    {
+        std::shared_ptr<RowHistory> history;
+        if (depth > 0 && rows > 0)
+            history = std::make_shared<RowHistory>((size_t)rows, depth, compact);
+        std::atomic_store(&this->Internals->history_, history);
+        this->Internals->history_column_ = std::min(std::max(column, 1), 3);
+        emit tableUpdate();
+    }
+
+    int SpreadSheet::rowHistoryDepth() const
+    {
+        std::shared_ptr<RowHistory> history = std::atomic_load(&this->Internals->history_);
+        return history ? history->depth() : 0;
+    }
+
+    size_t SpreadSheet::rowHistoryBytes() const
+    {
+        std::shared_ptr<RowHistory> history = std::atomic_load(&this->Internals->history_);
+        return history ? history->memoryBytes() : 0;
+    }
+
+    DatasPtr SpreadSheet::acquireBuffer(size_t rows)
+    {
+        return this->Internals->pool_->acquire(rows);
+    }
+
+    unsigned long long SpreadSheet::UpdateRows(const RowPatch* rows, size_t count)
+    {
+        if (!rows || !count)
+            return 0;
+
+        if (std::shared_ptr<RowHistory> history = std::atomic_load(&this->Internals->history_))
+            history->append(rows, count);
+
+        RowPatchBatch batch;
+        batch.rows.assign(rows, rows + count);
+        unsigned long long sequence = 0;
+        bool woken = false;
+        {
+            std::lock_guard<std::mutex> lock(this->Internals->publish_lock_);
+            batch.sequence = sequence = ++this->Internals->sequence_;
+            this->Internals->patch_batches_++;
+            if (std::shared_ptr<FrameLogWriter> recorder = std::atomic_load(&this->Internals->recorder_))
+                recorder->addPatches(rows, count);
+            woken = this->Internals->builder_->pushPatches(std::move(batch));
         }
+        if (woken)
+            emit tableUpdate();
+        return sequence;
     }
 
-    void SpreadSheet::adjustRows(int rows)
+    unsigned long long SpreadSheet::UpdateRows(const std::vector<RowPatch>& rows)
     {
-        QStandardItemModel* tableModel = (QStandardItemModel*)this->dataTable->model();
-        int row_size = tableModel->rowCount();
-        int col_size = tableModel->columnCount();
+        return UpdateRows(rows.data(), rows.size());
+    }
 
-        // add rows
-        if (row_size > rows)
+    ColumnTablePtr SpreadSheet::acquireTable(const Schema& schema, size_t rows)
+    {
+        ColumnTablePtr table = this->Internals->table_pool_->acquire(rows);
+        table->setSchema(schema);
+        table->resize(rows);
+        return table;
+    }
+
+    BufferPoolStats SpreadSheet::bufferPoolStats() const
+    {
+        return this->Internals->pool_->stats();
+    }
+
+    BufferPoolStats SpreadSheet::tablePoolStats() const
+    {
+        return this->Internals->table_pool_->stats();
+    }
+
+    SortStats SpreadSheet::sortStats() const
+    {
+        TableModel* tableModel = (TableModel*)this->dataTable->model();
+        const PagePtr& page = tableModel->page();
+        return page ? page->sort_stats : SortStats();
+    }
+
+    bool SpreadSheet::setFilter(const QString& expression)
+    {
+        std::string text = expression.trimmed().toStdString();
+        TableModel* tableModel = (TableModel*)this->dataTable->model();
+        const ColumnTablePtr& data = tableModel->snapshot();
+
+        // checked against the schema on display, without data it is compiled with the first frame
+        RowFilter filter;
+        if (data && !filter.compile(text, data->schema()))
         {
-            int add = rows - row_size;// need to add new rows
-            for (int r = row_size; r < rows; ++r) {
-                for (int c = 0; c < col_size; ++c) {
-                    QStandardItem *item = NULL;
-
-                    if (c == 0)
-                    {
-                        QVariant v = r;
-                        item = new QStandardItem();
-                        item->setData(v, Qt::EditRole);
-                    }
-                    else
-                        item = new QStandardItem(QString("..."));
-                    tableModel->setItem(r, c, item);
-                }
-            }
+            this->Internals->Ui.filterLabel->setText(QString::fromStdString(filter.error()));
+            return false;
         }
 
-        // hide rows
-        if (rows != this->data_rows_)
+        this->Internals->filter_text_ = text;
+        emit tableUpdate();
+        return true;
+    }
+
+    QString SpreadSheet::filter() const
+    {
+        return QString::fromStdString(this->Internals->filter_text_);
+    }
+
+    int SpreadSheet::filterMatches() const
+    {
+        return this->Internals->filter_matches_;
+    }
+
+    void SpreadSheet::onFilterEdited()
+    {
+        setFilter(this->Internals->Ui.filterEdit->text());
+    }
+
+    void SpreadSheet::updateFilterLabel(int matches, int total)
+    {
+        if (this->Internals->filter_error_.size())
         {
-            this->dataTable->setUpdatesEnabled(false);
-            if (rows > this->data_rows_)// show more rows
-            {
-                for (int r = this->data_rows_; r < rows; ++r)
-                    this->dataTable->setRowHidden(r, false);
-            }
-            else if (rows < this->data_rows_)// hide more rows
-            {
-                for (int r = this->data_rows_ - 1; r >= rows; --r)
-                    this->dataTable->setRowHidden(r, true);
-            }
-            else
-            {
+            this->Internals->Ui.filterLabel->setText(this->Internals->filter_error_);
+            matches = -1;
+        }
+        if ((matches == this->Internals->filter_matches_) && (total == this->Internals->filter_total_))
+            return;
 
-            }
-            this->dataTable->setUpdatesEnabled(true);
-            this->data_rows_ = rows;
+        bool changed = (matches != this->Internals->filter_matches_);
+        this->Internals->filter_matches_ = matches;
+        this->Internals->filter_total_ = total;
+        if (this->Internals->filter_error_.isEmpty())
+        {
+            QString text;
+            if (matches >= 0)
+                text = QString("%1 / %2 rows").arg(matches).arg(total);
+            this->Internals->Ui.filterLabel->setText(text);
         }
+        if (changed)
+            emit filterMatched(matches);
     }
 
-    void SpreadSheet::getVisiableRow(int& first, int& last)
+    bool SpreadSheet::startRecording(const QString& path, bool delta)
     {
-        first = this->Internals->Ui.tableView->rowAt(0);// visiable first row 
-        last = this->Internals->Ui.tableView->rowAt(this->Internals->Ui.tableView->viewport()->rect().bottom());// visiable last row
+        stopRecording();
+        std::shared_ptr<FrameLogWriter> recorder = std::make_shared<FrameLogWriter>();
+        if (!recorder->open(path.toLocal8Bit().toStdString(), delta))
+            return false;
+        std::atomic_store(&this->Internals->recorder_, recorder);
+        return true;
     }
 
-    void SpreadSheet::Update(DatasPtr& data)
+    bool SpreadSheet::stopRecording()
+    {
+        // a producer still holding it adds its frame before the log is closed
+        std::shared_ptr<FrameLogWriter> recorder = std::atomic_exchange(&this->Internals->recorder_, std::shared_ptr<FrameLogWriter>());
+        if (!recorder)
+            return true;
+        return recorder->close();
+    }
+
+    bool SpreadSheet::recording() const
     {
+        return nullptr != std::atomic_load(&this->Internals->recorder_);
+    }
+
+    void SpreadSheet::setMaxFps(int fps)
+    {
+        this->Internals->max_fps_ = (fps > 0) ? fps : 0;
+    }
+
+    int SpreadSheet::maxFps() const
+    {
+        return this->Internals->max_fps_;
+    }
+
+    void SpreadSheet::scheduleUpdate()
+    {
+        this->Internals->requests_++;
+        QTimer* timer = this->Internals->frame_timer_;
+        if (timer->isActive())
+            return;// joins the frame already scheduled
+
+        // a hidden sheet leaves its updates queued, updateWorkPriority schedules a frame when it is shown
+        if (WorkPriority::Paused == this->Internals->priority_)
+            return;
+
+        // the next frame starts one display interval after the last one, or now if that is over
+        int wait = 0;
+        if ((this->Internals->max_fps_ > 0) && this->Internals->frame_clock_.isValid())
+            wait = std::max(0, 1000 / this->Internals->max_fps_ - (int)this->Internals->frame_clock_.elapsed());
+        timer->start(wait);
+    }
+
+    FrameStats SpreadSheet::frameStats() const
+    {
+        FrameStats stats = this->Internals->frame_stats_;
+        stats.requests = this->Internals->requests_;
+        stats.published = this->Internals->published_;
+        stats.dropped = this->Internals->builder_->dropped();
+        stats.patch_batches = this->Internals->patch_batches_;
+        stats.queue_depth = (this->Internals->builder_->pendingSnapshot() ? 1 : 0) + this->Internals->builder_->pendingBatches();
+        return stats;
+    }
+
+    void SpreadSheet::setStatsOverlay(bool show)
+    {
+        if (!show)
         {
-            std::lock_guard<std::mutex> lock(this->Internals->lock_);
-            this->Internals->data_.push(data);
+            delete this->Internals->overlay_;
+            this->Internals->overlay_ = nullptr;
+            return;
+        }
+        if (this->Internals->overlay_)
+            return;
+
+        QLabel* overlay = new QLabel(this->dataTable->viewport());
+        overlay->setAttribute(Qt::WA_TransparentForMouseEvents);
+        overlay->setStyleSheet("QLabel { color: white; background-color: rgba(0, 0, 0, 160); padding: 4px; }");
+        overlay->move(4, 4);
+        overlay->show();
+        this->Internals->overlay_ = overlay;
+        this->Internals->overlay_timer_.invalidate();
+        updateStatsOverlay();
+    }
+
+    bool SpreadSheet::statsOverlay() const
+    {
+        return nullptr != this->Internals->overlay_;
+    }
+
+    void SpreadSheet::setStatsFooter(bool show)
+    {
+        if (show == statsFooter())
+            return;
+        if (this->action_footer_->isChecked() != show)
+            this->action_footer_->setChecked(show);// toggled calls back in
+        if (show == statsFooter())
+            return;
+
+        this->Internals->Ui.statsView->setVisible(show);
+        if (!show)
+        {
+            this->Internals->stats_worker_.reset();
+            this->Internals->stats_ready_.take();
+            return;
         }
+
+        this->Internals->stats_worker_.reset(new ColumnStatsWorker(this->Internals->work_, [this](const TableStatsPtr& stats) {
+            // only the latest result is kept, the GUI thread is woken once
+            if (this->Internals->stats_ready_.publish(stats))
+                emit statsReady();
+        }));
+        this->Internals->stats_sequence_ = 0;
+        this->Internals->stats_rows_.reset();
+        emit tableUpdate();
+    }
+
+    bool SpreadSheet::statsFooter() const
+    {
+        return nullptr != this->Internals->stats_worker_;
+    }
+
+    void SpreadSheet::setStatsHistogram(int bins)
+    {
+        bins = std::max(0, bins);
+        if (bins == this->Internals->stats_bins_)
+            return;
+        this->Internals->stats_bins_ = bins;
+        this->Internals->stats_sequence_ = 0;// summed up again with the next frame
+        emit tableUpdate();
+    }
+
+    int SpreadSheet::statsHistogram() const
+    {
+        return this->Internals->stats_bins_;
+    }
+
+    TableStatsPtr SpreadSheet::columnStats() const
+    {
+        return this->Internals->stats_model_->stats();
+    }
+
+    void SpreadSheet::onStatsReady()
+    {
+        TableStatsPtr stats = this->Internals->stats_ready_.take();
+        if (!stats || !statsFooter())
+            return;
+
+        StatsModel* model = this->Internals->stats_model_;
+        int rows = model->rowCount();
+        model->setStats(stats);
+
+        // as high as its rows, the row titles as wide as the row numbers of the table to line up the columns
+        QTableView* statsView = this->Internals->Ui.statsView;
+        if (rows != model->rowCount())
+            statsView->setFixedHeight(model->rowCount() * statsView->verticalHeader()->defaultSectionSize() + 2);
+        statsView->verticalHeader()->setFixedWidth(this->dataTable->verticalHeader()->width());
+        emit columnStatsUpdated(stats->sequence);
+    }
+
+    void SpreadSheet::updateStatsOverlay()
+    {
+        QLabel* overlay = this->Internals->overlay_;
+        if (!overlay)
+            return;
+        // redrawn twice a second, the label should not cost what it measures
+        if (this->Internals->overlay_timer_.isValid() && this->Internals->overlay_timer_.elapsed() < 500)
+            return;
+        this->Internals->overlay_timer_.start();
+
+        FrameStats stats = frameStats();
+        double interval = stats.interval.mean();
+        QString text = QString::asprintf("fps %.1f  frames %llu  dropped %llu  queue %zu\n"
+            "ms p50/p99  take %.2f/%.2f  roi %.2f/%.2f  sort %.2f/%.2f  format %.2f/%.2f\n"
+            "rows %.2f/%.2f  model %.2f/%.2f  gui %.2f/%.2f  total %.2f/%.2f",
+            interval > 0 ? 1000.0 / interval : 0.0, stats.frames, stats.dropped, stats.queue_depth,
+            stats.take.percentile(0.5), stats.take.percentile(0.99),
+            stats.roi.percentile(0.5), stats.roi.percentile(0.99),
+            stats.sort.percentile(0.5), stats.sort.percentile(0.99),
+            stats.format.percentile(0.5), stats.format.percentile(0.99),
+            stats.rows.percentile(0.5), stats.rows.percentile(0.99),
+            stats.model.percentile(0.5), stats.model.percentile(0.99),
+            stats.gui.percentile(0.5), stats.gui.percentile(0.99),
+            stats.total.percentile(0.5), stats.total.percentile(0.99));
+        overlay->setText(text);
+        overlay->adjustSize();
+        overlay->raise();
     }
 
     void SpreadSheet::reject()
@@ -292,35 +734,12 @@ namespace tool
     //Ctrl + C copy
     bool SpreadSheet::event(QEvent *event)
     {
+        if ((QEvent::Show == event->type()) || (QEvent::Hide == event->type()) || (QEvent::ParentChange == event->type()))
+            updateWorkPriority();
         if (event->type() == QEvent::KeyPress) {
             QKeyEvent *keyEvent = static_cast<QKeyEvent *>(event);
             if (keyEvent->matches(QKeySequence::Copy)) {
-                QString copied_text;
-
-                //QAbstractItemModel * model = this->pointTable->model();
-                QItemSelectionModel * selection = this->dataTable->selectionModel();
-                QModelIndexList indexes = selection->selectedIndexes();
-                if (!indexes.size())
-                {
-                    event->accept();
-                    return true;
-                }
-                int current_row = indexes.at(0).row();
-                for (int i = 0; i < indexes.count(); i++) {
-                    if (current_row != indexes.at(i).row()) {
-                        current_row = indexes.at(i).row();
-                        copied_text.append("\n");
-                        copied_text.append(indexes.at(i).data().toString());
-                        continue;
-                    }
-                    if (0 != i) {
-                        copied_text.append("\t");
-                    }
-                    copied_text.append(indexes.at(i).data().toString());
-                }
-                copied_text.append("\n");
-                QClipboard *clb = QApplication::clipboard();
-                clb->setText(copied_text);
+                copySelection();
                 event->accept();
                 return true;
             }
@@ -328,12 +747,76 @@ namespace tool
         return QWidget::event(event);
     }
 
-    void SpreadSheet::updatePoiRegion(std::vector<int>& indexs, bool roi_mode)
+    bool SpreadSheet::eventFilter(QObject* watched, QEvent* event)
+    {
+        if (watched == this->Internals->watched_window_.data())
+        {
+            switch (event->type())
+            {
+            case QEvent::WindowStateChange:
+            case QEvent::WindowActivate:
+            case QEvent::WindowDeactivate:
+                updateWorkPriority();
+                break;
+            default:
+                break;
+            }
+        }
+        return QWidget::eventFilter(watched, event);
+    }
+
+    void SpreadSheet::updateWorkPriority()
+    {
+        // minimising only changes the state of the window, it is watched
+        QWidget* window = this->window();
+        if (window != this->Internals->watched_window_.data())
+        {
+            if (this->Internals->watched_window_)
+                this->Internals->watched_window_->removeEventFilter(this);
+            this->Internals->watched_window_ = window;
+            window->installEventFilter(this);
+        }
+
+        WorkPriority priority = WorkPriority::Visible;
+        if (!isVisible() || window->isMinimized())
+            priority = WorkPriority::Paused;
+        else if (!window->isActiveWindow())
+            priority = WorkPriority::Background;
+        if (priority == this->Internals->priority_)
+            return;
+
+        bool resumed = (WorkPriority::Paused == this->Internals->priority_);
+        this->Internals->priority_ = priority;
+        this->Internals->work_->setPriority(priority);
+        if (resumed)
+        {
+            // the updates queued while hidden are shown now
+            this->Internals->frame_timer_->stop();
+            scheduleUpdate();
+        }
+    }
+
+    WorkPriority SpreadSheet::workPriority() const
+    {
+        return this->Internals->priority_;
+    }
+
+    void SpreadSheet::updatePoiRegion(const std::vector<int>& indexs, bool roi_mode)
     {
-        // release lock before emit, resource busy
+        updatePoiRegion(std::make_shared<const RowSet>(indexs), roi_mode);
+    }
+
+    void SpreadSheet::updatePoiRegion(std::vector<int>&& indexs, bool roi_mode)
+    {
+        updatePoiRegion(std::make_shared<const RowSet>(std::move(indexs)), roi_mode);
+    }
+
+    void SpreadSheet::updatePoiRegion(RowSetPtr indexs, bool roi_mode)
+    {
+        // release lock before emit, resource busy. only the handle is swapped under the lock
         {
             std::lock_guard<std::mutex> lock(this->Internals->lock_);
-            this->Internals->idxs_ = indexs;
+            this->Internals->idxs_.swap(indexs);
             this->Internals->roi_mode_ = roi_mode;
         }
         emit tableUpdate();
@@ -356,185 +839,123 @@ namespace tool
         return;
     }
 
-    // http://www.cplusplus.com/forum/beginner/116101/
-    template <typename Container>
-    struct compare_indirect_index
+    void SpreadSheet::slotUpdate()
     {
-        const Container& container;
-        compare_indirect_index(const Container& container) : container(container) { }
-        bool operator () (size_t lindex, size_t rindex) const
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point time_start = Clock::now();
+        this->Internals->frame_clock_.start();
+        if (WorkPriority::Paused == this->Internals->priority_)
+            return;// no one sees it, the updates wait in the builder until it is shown again
+
+        PageRequest request;
+        request.requested = time_start;
+        request.sort_keys = this->sort_keys_;
+        request.visible_only = (SortVisibleRows == this->sort_mode_);
+        request.filter = this->Internals->filter_text_;
+        request.decimals = this->precision_;
+        request.fade_ms = this->Internals->delegate_->changeFade();
+        request.history = std::atomic_load(&this->Internals->history_);
+        request.history_column = this->Internals->history_column_;
         {
-            return container[lindex] < container[rindex];
+            std::lock_guard<std::mutex> lock(this->Internals->lock_);
+            request.roi_mode = this->Internals->roi_mode_;
+            if (request.roi_mode)
+                request.roi = this->Internals->idxs_;
         }
-    };
-
-    template <typename Container>
-    void sort_data(Container& v, std::vector<size_t>& idx, bool is_ascend = true)
-    {
-        // initialize original index locations
-        iota(idx.begin(), idx.end(), 0);
 
-        // sort indexes based on comparing values in v
-        // using std::stable_sort instead of std::sort
-        // to avoid unnecessary index re-orderings
-        // when v contains elements of equal values
-        std::stable_sort(idx.begin(), idx.end(), compare_indirect_index <decltype(v)>(v));
-        if (!is_ascend)
-        {
-            std::reverse(idx.begin(), idx.end());
-        }
-        return;
+        // the rows the viewport can hold from the first visible one and a band around them, they are formatted
+        // with the page (and ordered in SortVisibleRows mode)
+        QTableView* view = this->Internals->Ui.tableView;
+        int viewport_rows = view->viewport()->height() / std::max(1, view->verticalHeader()->defaultSectionSize()) + 2;
+        int band = prefetch_viewports * viewport_rows;
+        request.first = std::max(0, view->rowAt(0) - band);
+        request.count = viewport_rows + 2 * band;
+        this->Internals->builder_->request(request);
+        this->Internals->request_ms_ = elapsed_ms(time_start, Clock::now());
     }
 
-    void SpreadSheet::slotUpdate()
+    void SpreadSheet::onPageReady()
     {
-        QStandardItemModel* tableModel = (QStandardItemModel*)this->dataTable->model();
-        DatasPtr data_ori = NULL;
-        DatasPtr data = NULL;
-        {
-            std::lock_guard<std::mutex> lock(this->Internals->lock_);
-            data_ori = this->Internals->current_;
-            if (!data_ori)
-                return;
-
-            if (this->Internals->roi_mode_)
-            {
-                DatasPtr roi(new Datas);
-                DatasPtr full = data_ori;
-
-                roi->resize(this->Internals->idxs_.size());
-                int it = 0;
-                for (auto& id : this->Internals->idxs_)
-                {
-                    DataStruct& p_roi = roi->at(it);
-                    DataStruct& p_full = full->at(id);
-                    p_roi = p_full;
-                    it++;
-                }
-                data = roi;
-            }
-            else
-            {
-                data = data_ori;
-            }
-        }
-
-        if (!data)
+        PagePtr page = this->Internals->page_ready_.take();
+        if (!page)
             return;
 
-        // sort data
-        int sort_column = this->dataTable->horizontalHeader()->sortIndicatorSection();
-        std::vector<size_t> index(data->size());
-        std::iota(std::begin(index), std::end(index), 0); // fill index with {0,1,2,...} This only needs to happen once
-        bool is_ascend = true;
-        if (Qt::SortOrder::AscendingOrder != this->dataTable->horizontalHeader()->sortIndicatorOrder())// 0 is AscendingOrder, 1 is DescendingOrder
-            is_ascend = false;
-        if (1)
-        {
-            if (sort_column > 2)// float
-            {
-                std::vector<double> values(data->size());
-                for (int i = 0; i < data->size();i++)
-                {
-                    DataStruct& it = data->at(i);
-                    float v = .0f;
-                    switch (sort_column)
-                    {
-                    case 3:
-                        v = it.v3;
-                        break;
-                    default:
-                        break;
-                    }
-                    values[i] = v;
-                }
-                sort_data(values, index, is_ascend);
-            }
-            else if ((sort_column >= 0) && (sort_column <= 2))
-            {
-                std::vector<int> values(data->size());
-                for (int i = 0; i < data->size(); i++)
-                {
-                    DataStruct& it = data->at(i);
-                    int v = 0;
-                    switch (sort_column)
-                    {
-                    case 0:
-                        v = it.idx;
-                        break;
-                    case 1:
-                        v = it.v1;
-                        break;
-                    case 2:
-                        v = it.v2;
-                        break;
-                    case 3:
-                        v = it.v3;
-                        break;
-                    default:
-                        break;
-                    }
-                    values[i] = v;
-                }
-                sort_data(values, index, is_ascend);
-            }
-            else
-            {
-                return;
-            }
-        }
-        int new_size = data->size();
-        adjustRows(new_size);
-        if (new_size <= 0)
-            return;
+        using Clock = std::chrono::steady_clock;
+        Clock::time_point time_start = Clock::now();
+        TableModel* tableModel = (TableModel*)this->dataTable->model();
+        adjustRows(page->size);
 
         int visible_first = -1;
         int visible_last = -1;
         getVisiableRow(visible_first, visible_last);
+        if (visible_first < 0)
+            visible_first = 0;
         if (-1 == visible_last)// if data columns is less than the view columns, show all data
-            visible_last = new_size;
-
-        this->dataTable->setUpdatesEnabled(false);
-        for (int r = visible_first; r <= visible_last; ++r) {
-            if (r >= new_size)
-                continue;
-            int rr = index[r];
-            if (rr >= new_size)
-                continue;
-
-            DataStruct& v = data->at(rr);
-            tableModel->item(r, 0)->setData(v.idx, Qt::EditRole);
-            tableModel->item(r, 1)->setData(v.v1, Qt::EditRole);
-            tableModel->item(r, 2)->setData(v.v2, Qt::EditRole);
-            tableModel->item(r, 3)->setData(int(v.v3 * 1000) / 1000.0, Qt::EditRole);
-        }
-        this->dataTable->setUpdatesEnabled(true);
-        return;
-    }
+            visible_last = page->size - 1;
+        Clock::time_point time_rows = Clock::now();
 
-    void SpreadSheet::onCustomContextMenuRequested(const QPoint &pos)
-    {
-        QItemSelectionModel * selection = this->dataTable->selectionModel();
-        QModelIndexList indexes = selection->selectedIndexes();
+        this->Internals->filter_error_ = QString::fromStdString(page->filter_error);
+        updateFilterLabel(page->filter_matches, page->filter_total);
 
-        if (!indexes.size())
-        {
-            this->action_copy_->setDisabled(true);
-        }
-        else
+        // the footer sums up the same rows on the pool, all of them (see ColumnStatsWorker)
+        const ColumnTablePtr& data = page->data;
+        if (this->Internals->stats_worker_ && ((data->sequence() != this->Internals->stats_sequence_) || (page->rows != this->Internals->stats_rows_)))
         {
-            this->action_copy_->setDisabled(false);
+            this->Internals->stats_sequence_ = data->sequence();
+            this->Internals->stats_rows_ = page->rows;
+            this->Internals->stats_worker_->request(data, page->rows, this->Internals->stats_bins_);
         }
 
-        if (1 == indexes.size())
-        {
-            this->action_select_col_->setDisabled(false);
-        }
-        else
+        tableModel->setPage(page);
+
+        // only the visible cells are repainted, the page has their text. an empty page (no row of
+        // interest, a filter matching nothing) has none but is shown and counted all the same
+        if (page->size > 0)
         {
-            this->action_select_col_->setDisabled(true);
+            tableModel->refreshRows(visible_first, visible_last);
+            if (page->last_change_ms && !this->Internals->fade_timer_->isActive())
+                this->Internals->fade_timer_->start();
         }
+        Clock::time_point time_model = Clock::now();
+
+        FrameStats& stats = this->Internals->frame_stats_;
+        stats.take.add(page->take_ms);
+        stats.roi.add(page->roi_ms);
+        stats.sort.add(page->sort_ms);
+        stats.format.add(page->format_ms);
+        stats.rows.add(elapsed_ms(time_start, time_rows));
+        stats.model.add(elapsed_ms(time_rows, time_model));
+        stats.gui.add(this->Internals->request_ms_ + elapsed_ms(time_start, time_model));
+        stats.total.add(elapsed_ms(page->requested, time_model));
+        if (stats.frames)
+            stats.interval.add(elapsed_ms(this->Internals->last_frame_, time_start));
+        stats.frames++;
+        this->Internals->last_frame_ = time_start;
+        updateStatsOverlay();
+
+        emit frameShown(data->sequence());
+        return;
+    }
+
+    void SpreadSheet::onFadeTick()
+    {
+        // the tint of the last change is gone, the next page with a change starts the timer again
+        const PagePtr& page = ((TableModel*)this->dataTable->model())->page();
+        int fade_ms = this->Internals->delegate_->changeFade();
+        if (!page || !page->last_change_ms || (change_clock_ms() - page->last_change_ms >= (uint32_t)fade_ms))
+            this->Internals->fade_timer_->stop();
+        this->dataTable->viewport()->update();
+    }
+
+    void SpreadSheet::onCustomContextMenuRequested(const QPoint &pos)
+    {
+        // ranges, not every selected index
+        QItemSelectionModel * selection = this->dataTable->selectionModel();
+        QItemSelection ranges = selection->selection();
+        bool single = (1 == ranges.size()) && (ranges.at(0).top() == ranges.at(0).bottom()) && (ranges.at(0).left() == ranges.at(0).right());
 
+        this->action_copy_->setDisabled(!selection->hasSelection());
+        this->action_select_col_->setDisabled(!single);
 
         this->right_popup_menu_->exec(QCursor::pos());
     }
@@ -558,180 +979,169 @@ namespace tool
     /*copy*/
     void SpreadSheet::onActionCopy()
     {
-        QString copied_text;
-        QItemSelectionModel * selection = this->dataTable->selectionModel();
-        QModelIndexList indexes = selection->selectedIndexes();
-        QModelIndex index;
+        copySelection();
+    }
 
-        if (!indexes.size())
+    void SpreadSheet::copySelection()
+    {
+        // the selection as ranges, a selected column of 100k rows is one range and not 100k indexes
+        std::vector<CellRange> ranges;
+        QItemSelection selection = this->dataTable->selectionModel()->selection();
+        for (auto& it : selection)
         {
+            CellRange range;
+            range.top = it.top();
+            range.bottom = it.bottom();
+            range.left = it.left();
+            range.right = it.right();
+            ranges.push_back(range);
+        }
+        TableModel* tableModel = (TableModel*)this->dataTable->model();
+        const ColumnTablePtr& data = tableModel->snapshot();
+        if (ranges.empty() || !data)
             return;
+
+        // cells out of the sorted window (SortVisibleRows) read "...", the job orders all rows first
+        bool ordered = true;
+        for (auto& it : ranges)
+        {
+            if (it.top < tableModel->sortedFirst() || it.bottom > tableModel->sortedLast())
+                ordered = false;
         }
 
-        int current_row = indexes.at(0).row();
-        for (int i = 0; i < indexes.count(); i++) {
-            if (i == 0)
-            {
-                copied_text.append("\n");
-            }
-            if (current_row != indexes.at(i).row()) {
-                current_row = indexes.at(i).row();
-                if (!this->dataTable->isRowHidden(current_row))
-                {
-                    copied_text.append("\n");
-                    copied_text.append(indexes.at(i).data().toString());
-                }
-                continue;
-            }
-            if (0 != i) {
-                copied_text.append("\t");
-            }
+        if (ordered && count_cells(ranges) <= copy_sync_cells)
+        {
+            this->Internals->copy_.reset();// an older copy must not overwrite this one
+            this->Internals->copied_.take();
+            std::string text;
+            format_selection(*data, tableModel->rowSet().get(), tableModel->permutation(), ranges, text);
+            setClipboard(text);
+            return;
+        }
 
-            if (!this->dataTable->isRowHidden(indexes.at(i).row()))
-            {
-                copied_text.append(indexes.at(i).data().toString());
-            }
+        // the permutation is copied, the model swaps in a new one every frame
+        CopyJob::Order order;
+        if (!ordered)
+        {
+            SortKeys sort_keys = valid_sort_keys(*data, this->sort_keys_);
+            if (sort_keys.empty())
+                return;
+            order = [sort_keys](const ColumnTable& table, const RowSet* rows, std::vector<size_t>& index) {
+                sort_by_keys(table, sort_keys, rows, index);
+            };
         }
-        copied_text.append("\n");
-        QClipboard *clb = QApplication::clipboard();
-        QString originalText = clb->text();
-        clb->setText(copied_text);
+        std::vector<size_t> index;
+        if (ordered)
+            index = tableModel->permutation();
+        this->Internals->copy_.reset(new CopyJob(data, tableModel->rowSet(), std::move(index), std::move(ranges)));
+        this->Internals->copy_->start(order, [this](std::string& text) {
+            this->Internals->copied_.publish(std::make_shared<std::string>(std::move(text)));
+            emit copyReady();
+        });
     }
 
-    void SpreadSheet::onActionExport()
+    void SpreadSheet::onCopyReady()
     {
-        QString filename = QFileDialog::getSaveFileName(this, "Save to file");
-        if (!filename.size())
+        std::shared_ptr<std::string> text = this->Internals->copied_.take();
+        if (!text)
             return;
-
-        DatasPtr data_ori = NULL;
-        DatasPtr data = NULL;
+        if (this->Internals->copy_)
         {
-            std::lock_guard<std::mutex> lock(this->Internals->lock_);
-            data_ori = this->Internals->current_;
-            if (!data_ori)
-                return;
-
-            if (this->Internals->roi_mode_)
-            {
-                DatasPtr roi(new Datas());
-                DatasPtr full = data_ori;
-
-                roi->resize(this->Internals->idxs_.size());
-                int it = 0;
-                for (auto& id : this->Internals->idxs_)
-                {
-                    DataStruct& p_roi = roi->at(it);
-                    DataStruct& p_full = full->at(id);
-                    p_roi = p_full;
-                    it++;
-                }
-                data = roi;
-            }
-            else
-            {
-                data = data_ori;
-            }
+            this->Internals->copy_->wait();
+            this->Internals->copy_.reset();
         }
+        setClipboard(*text);
+    }
 
-        if (!data)
-            return;
+    void SpreadSheet::setClipboard(const std::string& text)
+    {
+        // text/plain is read as UTF-8, the bytes are handed over without a QString in between
+        QMimeData* mime = new QMimeData();
+        mime->setData("text/plain", QByteArray(text.data(), (int)text.size()));
+        QApplication::clipboard()->setMimeData(mime);
+    }
 
-        // sort data
-        int sort_column = this->dataTable->horizontalHeader()->sortIndicatorSection();
-        std::vector<size_t> index(data->size());
-        std::iota(std::begin(index), std::end(index), 0); // fill index with {0,1,2,...} This only needs to happen once
-        bool is_ascend = true;
-        if (Qt::SortOrder::AscendingOrder != this->dataTable->horizontalHeader()->sortIndicatorOrder())// 0 is AscendingOrder, 1 is DescendingOrder
-            is_ascend = false;
-        if (/*this->Internals->need_reorder_ && */1)
+    void SpreadSheet::onActionExport()
+    {
+        if (exporting())// the action reads Cancel Export meanwhile
         {
-            //this->Internals->need_reorder_ = false;
-            if (sort_column > 2)// float
-            {
-                std::vector<double> values(data->size());
-                for (int i = 0; i < data->size(); i++)
-                {
-                    DataStruct& it = data->at(i);
-                    float v = .0f;
-                    switch (sort_column)
-                    {
-                    case 3:
-                        v = it.v3;
-                        break;
-                    default:
-                        break;
-                    }
-                    values[i] = v;
-                }
-                sort_data(values, index, is_ascend);
-            }
-            else if ((sort_column >= 0) && (sort_column <= 2))
-            {
-                std::vector<int> values(data->size());
-                for (int i = 0; i < data->size(); i++)
-                {
-                    DataStruct& it = data->at(i);
-                    int v = 0;
-                    switch (sort_column)
-                    {
-                    case 0:
-                        v = it.idx;
-                        break;
-                    case 1:
-                        v = it.v1;
-                        break;
-                    case 2:
-                        v = it.v2;
-                        break;
-                    case 3:
-                        v = it.v3;
-                        break;
-                    default:
-                        break;
-                    }
-                    values[i] = v;
-                }
-                sort_data(values, index, is_ascend);
-            }
-            else
-            {
-                return;
-            }
+            cancelExport();
+            return;
         }
-        int new_size = data->size();
-        if (new_size <= 0)
+
+        QString filename = QFileDialog::getSaveFileName(this, "Save to file");
+        if (!filename.size())
             return;
 
-        std::string name = filename.toLocal8Bit().toStdString();
-        std::ofstream out(name);
-        if (!out.is_open())
-        {
-            QMessageBox::warning(this, "Warning", "Open file error.");
+        // the rows of the page on display, ROI and filter applied
+        TableModel* tableModel = (TableModel*)this->dataTable->model();
+        ColumnTablePtr data = tableModel->snapshot();
+        RowSetPtr roi = tableModel->rowSet();
+        if (!data || data->size() <= 0 || (roi && roi->empty()))
             return;
-        }
 
-        const int buffer_len = 1024;
-        std::unique_ptr<char> buffer(new char[buffer_len]);
-        char* ptr = buffer.get();
-        for (int r = 0; r < new_size; ++r) {
-            if (r >= index.size())
-                continue;
-            int rr = index[r];
-            if (rr >= new_size)
-                continue;
-
-            int pos = 0;
-            DataStruct& v = data->at(rr);
-            pos += snprintf(ptr + pos, buffer_len - pos, "%d %d %d %.3f", v.idx, v.v1, v.v2, v.v3);
-            out << std::string(ptr);
-        }
-        out.close();
+        SortKeys sort_keys = valid_sort_keys(*data, this->sort_keys_);
+        if (sort_keys.empty())
+            return;
+
+        // the job holds data, patches of the current snapshot copy it first (PageBuilder::writable)
+        std::string name = filename.toLocal8Bit().toStdString();
+        this->Internals->export_.reset(new ExportJob(data, name, roi));
+        this->Internals->export_->start(
+            [sort_keys](const ColumnTable& table, const RowSet* rows, std::vector<size_t>& index) {
+                sort_by_keys(table, sort_keys, rows, index);
+            },
+            [this](size_t done, size_t total) {
+                emit exportProgress((int)(done * 100 / total));
+            },
+            [this](bool ok, const std::string& message) {
+                emit exportFinished(ok, QString::fromStdString(message));
+            });
+        this->action_export_->setText(tr("Cancel Export"));
         return;
     }
 
+    void SpreadSheet::cancelExport()
+    {
+        if (this->Internals->export_)
+            this->Internals->export_->cancel();
+    }
+
+    bool SpreadSheet::exporting() const
+    {
+        return this->Internals->export_ && this->Internals->export_->running();
+    }
+
+    void SpreadSheet::onExportFinished(bool ok, QString message)
+    {
+        if (this->Internals->export_)
+        {
+            this->Internals->export_->wait();
+            this->Internals->export_.reset();
+        }
+        this->action_export_->setText(tr("Export"));
+        if (!ok && message.size())
+            QMessageBox::warning(this, "Warning", message);
+    }
+
     void SpreadSheet::verticalScrollMoved(int value)
     {
+        // the view repaints the rows scrolled in, the page has them formatted while the viewport stays
+        // half a viewport inside its band. closer to the edge a page is asked for, the builder keeps the
+        // permutation and only formats the new rows
+        int first = -1;
+        int last = -1;
+        getVisiableRow(first, last);
+        TableModel* tableModel = (TableModel*)this->dataTable->model();
+        const PagePtr& page = tableModel->page();
+        if (page && (first >= 0) && (last >= first))
+        {
+            int margin = (last - first + 1) / 2;
+            bool top = (page->first == 0) || (first - margin >= page->first);
+            bool bottom = (page->first + page->count >= page->size) || (last + margin < page->first + page->count);
+            if (top && bottom)
+                return;
+        }
         emit tableUpdate();
     }
 
@@ -742,41 +1152,19 @@ namespace tool
 
     void SpreadSheet::sortIndicatorChanged(int logicalindex, Qt::SortOrder order)//order indicator changded
     {
-        static int order_col = 0;// record the last order column number
-        this->order_ = order;
-        this->sort_column_ = logicalindex;
-        QString ascend_label = " ^";
-        QString descend_label = " v";
-        QStandardItemModel* tableModel = (QStandardItemModel*)this->dataTable->horizontalHeader()->model();
-        QString title = "";
-        QString new_title = title;
-
-        // remove the old sort title order label(^ or v)
-        title = this->dataTable->model()->headerData(order_col, Qt::Horizontal).toString();
-        if (order_col != logicalindex)
+        if (!(QApplication::keyboardModifiers() & Qt::ShiftModifier))
         {
-            if (title.endsWith(ascend_label) || title.endsWith(descend_label))
-            {
-                new_title = title.mid(0, title.size() - 2);
-                this->dataTable->model()->setHeaderData(order_col, Qt::Horizontal, new_title);
-            }
+            setSortKeys({ { logicalindex, Qt::AscendingOrder == order } });
+            return;
         }
 
-        // set new sort title title order label(^ or v)
-        title = this->dataTable->model()->headerData(logicalindex, Qt::Horizontal).toString();
-        new_title = title;
-        if (title.endsWith(ascend_label) || title.endsWith(descend_label))
-        {
-            new_title = title.mid(0, title.size() - 2);
-        }
-        if (Qt::SortOrder::AscendingOrder == order)
-            new_title += QString(ascend_label);
-        else if (Qt::SortOrder::DescendingOrder == order)
-            new_title += QString(descend_label);
+        // shift+click: one more key, or the other order of a key already there
+        SortKeys keys = this->sort_keys_;
+        auto it = std::find_if(keys.begin(), keys.end(), [logicalindex](const SortKey& k) { return k.column == logicalindex; });
+        if (it != keys.end())
+            it->ascend = !it->ascend;
         else
-            ;
-        this->dataTable->model()->setHeaderData(logicalindex, Qt::Horizontal, new_title);
-        order_col = logicalindex;
-        emit tableUpdate();
+            keys.push_back({ logicalindex, true });
+        setSortKeys(keys);
     }
 }
@@ -1,63 +1,202 @@
 #ifndef SPREAD_SHEET_H
 #define SPREAD_SHEET_H
 
+#include <QColor>
 #include <QWidget>
 #include <QTableView>
 #include <QAbstractTableModel>
 #include <QStyledItemDelegate>
 #include <QPair>
 #include <QSet>
-#include <thread>
+#include <memory>
+#include "buffer_pool.h"
+#include "column_stats.h"
+#include "column_table.h"
+#include "frame_stats.h"
+#include "page_builder.h"
+#include "row_history.h"
+#include "sort_key.h"
+#include "worker_pool.h"
 
 class QItemSelection;
 
 namespace tool
 {
-    typedef struct DataStruct {
-        int idx = 0;
-        int v1 = 0;
-        int v2 = 0;
-        float v3 = 0.0;
-    }DataStruct;
-
-    using Datas = std::vector<DataStruct>;
-    using DatasPtr = std::shared_ptr<Datas>;
-
     class SpreadSheet : public QWidget
     {
         Q_OBJECT
 
     public:
+        // how much of the permutation is ordered every frame
+        enum SortMode
+        {
+            SortAllRows,// stable sort of all rows
+            SortVisibleRows,// select and order only the visible ranks
+        };
+
         SpreadSheet(int row, int col, QWidget* parent = 0);
         ~SpreadSheet();
 
         virtual bool event(QEvent *e);
-
-        //update the indexs which are interested
-        void updatePoiRegion(std::vector<int>& indexs, bool roi_mode = true);
+        virtual bool eventFilter(QObject* watched, QEvent* event);
+
+        //update the indexs which are interested, thread safe. the list is copied, moved in,
+        // or shared as it is (it must not be changed afterwards); rows out of the snapshot are skipped
+        void updatePoiRegion(const std::vector<int>& indexs, bool roi_mode = true);
+        void updatePoiRegion(std::vector<int>&& indexs, bool roi_mode = true);
+        void updatePoiRegion(RowSetPtr indexs, bool roi_mode = true);
+
+        // buffer of rows elements for the producer to fill and pass to Update, thread safe.
+        // it goes back to the pool when the last reference drops, the old contents are not cleared
+        DatasPtr acquireBuffer(size_t rows);
+        BufferPoolStats bufferPoolStats() const;
+
+        // table with the schema and rows rows, to fill column by column and pass to Update, thread safe
+        ColumnTablePtr acquireTable(const Schema& schema, size_t rows);
+        BufferPoolStats tablePoolStats() const;
+
+        // counters of the ordering paths up to the page on display, GUI thread only
+        SortStats sortStats() const;
+
+        // counters of the producers and the handoff, rolling timings of the frame stages on the page builder
+        // and the GUI thread, GUI thread only
+        FrameStats frameStats() const;
+
+        bool statsOverlay() const;
+
+        // min/max/sum/mean/stddev of every column over the rows of the last frame (ROI and filter applied),
+        // null before the first result. computed on a worker thread from the frame's snapshot, GUI thread only
+        TableStatsPtr columnStats() const;
+        bool statsFooter() const;
+
+        // the footer gets a histogram row of bins bins, 0 (the default) has none
+        void setStatsHistogram(int bins);
+        int statsHistogram() const;
+
+        // set how the rows are ordered for display, export always sorts all rows
+        void setSortMode(SortMode mode);
+        SortMode sortMode() const;
+
+        // order the rows by several columns, the first key decides and the next ones break its ties.
+        // a click on a header sorts by that column alone, a shift+click adds it as the next key (or flips
+        // its order if it is one already). keys of columns the snapshot does not have are skipped
+        void setSortKeys(const SortKeys& keys);
+        SortKeys sortKeys() const;
+
+        // floating values of column are shown with decimals decimals, 3 by default (a negative value goes
+        // back to it). copy and export write 3 decimals
+        void setColumnPrecision(int column, int decimals);
+        int columnPrecision(int column) const;
+
+        // cells whose value changed since the previous frame get a tint of color, fading out over fade_ms.
+        // only the rows around the viewport are compared, 0 (the default) looks for no changes
+        void setChangeHighlight(int fade_ms, const QColor& color = QColor(255, 200, 0));
+        int changeHighlight() const;
+
+        // keep the last depth values of v1, v2 and v3 of every row idx below rows (see RowHistory), appended
+        // by every Update and UpdateRows in the legacy layout, and show those of column (1 v1, 2 v2, 3 v3)
+        // as a sparkline column after the others. compact keeps 16 bits per value. 0 depth drops it
+        void setRowHistory(int depth, int rows, bool compact = false, int column = 1);
+        int rowHistoryDepth() const;
+        // bytes the history holds, fixed by setRowHistory
+        size_t rowHistoryBytes() const;
+
+        // an export started from the menu is still writing
+        bool exporting() const;
+
+        // show only the rows matching expression, e.g. "v1 > 5000 && v3 < 0.5" (see RowFilter), on top of
+        // the ROI. every frame is filtered before sorting, an empty expression shows all rows. GUI thread only.
+        // return false if it does not compile against the schema on display, the last filter stays then
+        bool setFilter(const QString& expression);
+        QString filter() const;
+
+        // rows matching the filter in the last frame, -1 without filter
+        int filterMatches() const;
+
+        // append every Update and UpdateRows from now on to a frame log at path (see FrameLogWriter),
+        // snapshots close to the previous one as their changed rows if delta. thread safe.
+        // a running recording is closed first, return false if the file can not be opened
+        bool startRecording(const QString& path, bool delta = true);
+        // write what is queued and close the log, false if a write failed
+        bool stopRecording();
+        bool recording() const;
+
+        // the background work of this sheet (column stats, the parallel passes of sorting, copy and export)
+        // runs on the WorkerPool shared by all sheets: Visible in the active window, Background in another
+        // one, Paused when hidden or minimised. a paused sheet does no work, its updates stay queued (the
+        // latest snapshot, the patches merged by the producers) and the latest frame is shown when it is
+        // visible again. GUI thread only
+        WorkPriority workPriority() const;
+
+        // refreshes per second at most, new data, scrolling and sorting in between are merged
+        // into one frame. 0 refreshes as soon as the event loop is idle, 60 by default
+        void setMaxFps(int fps);
+        int maxFps() const;
 
         public slots:
         virtual	void	reject();
 
+        // rows of the legacy layout, shown with ColumnTable::legacySchema
         void Update(DatasPtr&);
 
+        // any schema, the columns and titles follow it
+        void Update(ColumnTablePtr&);
+
+        // write only the changed rows into the current snapshot (legacy layout), thread safe.
+        // only the patched rows are re-sorted, patches older than the latest Update are dropped.
+        // return the sequence of the batch (see ColumnTable::sequence), 0 if there was nothing to write
+        unsigned long long UpdateRows(const RowPatch* rows, size_t count);
+        unsigned long long UpdateRows(const std::vector<RowPatch>& rows);
+
+        // stop a running export, the partial file is removed
+        void cancelExport();
+
+        // draw the frame stats over the table, off by default (Show Stats in the menu)
+        void setStatsOverlay(bool show);
+
+        // show the column stats below the table, on by default (Show Column Stats in the menu).
+        // off, no stats are computed
+        void setStatsFooter(bool show);
+
     protected:
 
         virtual void closeEvent(QCloseEvent *event);
 
-        // update datas
-        void updateThread();
-
         // adjust rows
         void adjustRows(int row);
 
         // get the visiable row range
         void getVisiableRow(int& first, int& last);
 
+        // priority of the work group from the visibility of the sheet and the state of its window
+        void updateWorkPriority();
+
+        // refresh the text of the stats overlay, at most twice a second
+        void updateStatsOverlay();
+
+        // show the match count of the filter, -1 without filter
+        void updateFilterLabel(int matches, int total);
+
+        // put the selected cells on the clipboard as tab separated text, read from the snapshot on display
+        // through the sort permutation. large selections are formatted on a worker thread (see CopyJob)
+        void copySelection();
+
+        void setClipboard(const std::string& text);
+
         private slots :
 
+        // a refresh is needed, slotUpdate runs at the next frame
+        void scheduleUpdate();
+
+        // ask the page builder for a page of the current sort, ROI, filter and viewport
         void slotUpdate();
 
+        // a page of the builder is waiting, it is shown
+        void onPageReady();
+
+        // repaint the changed cells while their tint fades
+        void onFadeTick();
+
         /*right button menu*/
         void onCustomContextMenuRequested(const QPoint &pos);
 
@@ -70,22 +209,56 @@ namespace tool
         /*copy to */
         void onActionCopy();
 
-        /*export data to file*/
+        /*export data to file, in the background*/
         void onActionExport();
 
-        // not used
+        void onExportFinished(bool ok, QString message);
+
+        // return pressed in the filter box
+        void onFilterEdited();
+
+        // a result of the stats thread is waiting
+        void onStatsReady();
+
+        // the text of a CopyJob is waiting
+        void onCopyReady();
+
+        // the viewport moved, a page is asked for when it gets close to the edge of the rows formatted
         void verticalScrollMoved(int);
 
         // not used
         void headerClicked(int);
 
-        // not used
+        // a header was clicked, with shift the column is added to the sort keys
         void sortIndicatorChanged(int, Qt::SortOrder);
 
     signals:
 
         void tableUpdate();
 
+        // export progress 0 - 100 and its end, emitted from the export thread
+        void exportProgress(int percent);
+        void exportFinished(bool ok, QString message);
+
+        // the visible rows were refreshed from the snapshot of this sequence,
+        // every Update and UpdateRows up to it is on screen
+        void frameShown(unsigned long long sequence);
+
+        // the match count of the filter changed, -1 when it was removed
+        void filterMatched(int matches);
+
+        // the footer shows the column stats of the snapshot of this sequence
+        void columnStatsUpdated(unsigned long long sequence);
+
+        // emitted from the stats thread, see onStatsReady
+        void statsReady();
+
+        // emitted from the copy thread, see onCopyReady
+        void copyReady();
+
+        // emitted from the page builder, see onPageReady
+        void pageReady();
+
     private:
 
         QTableView* dataTable;
@@ -95,19 +268,16 @@ namespace tool
         QAction *action_select_all_;//select all action
         QAction *action_copy_;//copy action
         QAction *action_export_;//export data action
+        QAction *action_stats_;//show stats overlay action
+        QAction *action_footer_;//show column stats action
 
-        int sort_column_; // not used
-        Qt::SortOrder order_; // not used
-
-        std::shared_ptr<std::thread> refresh_task_;
+        SortKeys sort_keys_ = { SortKey() };// by the first column ascending at start
+        SortMode sort_mode_ = SortAllRows;
+        std::vector<int> precision_;// decimals per column, -1 for the default
 
-        int data_rows_ = 0;//not hide
-        int data_columns_ = 0;//not hide
-        
-        int visiable_first_row_ = -1;//visiable
-        int visiable_last_row_ = -1;//visiable
+        int data_rows_ = 0;// rows of the model, those of the last frame
 
-        int row_ = 102400; // buffer enough
+        int row_ = 102400; // expected rows, a hint only: the model follows the data size, any size
         int column_ = 11; // column
 
         class Internal;
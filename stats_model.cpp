@@ -0,0 +1,149 @@
+#include "stats_model.h"
+#include <algorithm>
+
+namespace tool
+{
+    namespace
+    {
+        enum StatsRow
+        {
+            RowCount,
+            RowMin,
+            RowMax,
+            RowSum,
+            RowMean,
+            RowStddev,
+            RowHistogram,
+        };
+
+        const char* row_titles[] = { "count", "min", "max", "sum", "mean", "stddev", "histogram" };
+
+        // one block character per bin, scaled to the largest bin
+        QString sparkline(const std::vector<unsigned>& histogram)
+        {
+            static const ushort blocks[] = { 0x2581, 0x2582, 0x2583, 0x2584, 0x2585, 0x2586, 0x2587, 0x2588 };
+            unsigned top = 0;
+            for (auto& it : histogram)
+                top = std::max(top, it);
+
+            QString text;
+            for (auto& it : histogram)
+            {
+                if (!it)
+                    text.append(QChar(' '));
+                else
+                    text.append(QChar(blocks[(size_t)(it - 1) * 8 / top]));
+            }
+            return text;
+        }
+    }
+
+    StatsModel::StatsModel(QObject* parent)
+        :QAbstractTableModel(parent)
+    {
+    }
+
+    StatsModel::~StatsModel()
+    {
+    }
+
+    int StatsModel::rowCount(const QModelIndex& parent) const
+    {
+        if (parent.isValid())
+            return 0;
+        return this->rows_;
+    }
+
+    int StatsModel::columnCount(const QModelIndex& parent) const
+    {
+        if (parent.isValid())
+            return 0;
+        return this->columns_;
+    }
+
+    QVariant StatsModel::data(const QModelIndex& index, int role) const
+    {
+        if (!index.isValid() || !this->stats_)
+            return QVariant();
+        int c = index.column();
+        if (c < 0 || c >= (int)this->stats_->columns.size())
+            return QVariant();
+        const ColumnStats& stats = this->stats_->columns[c];
+
+        // the bin counts of the histogram as tooltip
+        if ((Qt::ToolTipRole == role) && (RowHistogram == index.row()))
+        {
+            QString text;
+            for (auto& it : stats.histogram)
+                text += QString::number(it) + " ";
+            return text.trimmed();
+        }
+        if (Qt::DisplayRole != role)
+            return QVariant();
+
+        if (RowCount == index.row())
+            return (qulonglong)stats.count;
+        if (!stats.numeric || !stats.count)
+            return QVariant();// strings and columns without values have only a count
+        switch (index.row())
+        {
+        case RowMin:
+            return QString::number(stats.min, 'g', 8);
+        case RowMax:
+            return QString::number(stats.max, 'g', 8);
+        case RowSum:
+            return QString::number(stats.sum, 'g', 8);
+        case RowMean:
+            return QString::number(stats.mean, 'g', 8);
+        case RowStddev:
+            return QString::number(stats.stddev, 'g', 8);
+        case RowHistogram:
+            return sparkline(stats.histogram);
+        default:
+            break;
+        }
+        return QVariant();
+    }
+
+    QVariant StatsModel::headerData(int section, Qt::Orientation orientation, int role) const
+    {
+        if (Qt::DisplayRole != role)
+            return QVariant();
+        if ((Qt::Vertical == orientation) && section >= 0 && section < this->rows_)
+            return QString(row_titles[section]);
+        return QVariant();
+    }
+
+    Qt::ItemFlags StatsModel::flags(const QModelIndex& index) const
+    {
+        if (!index.isValid())
+            return Qt::NoItemFlags;
+        return Qt::ItemIsSelectable | Qt::ItemIsEnabled;// read only
+    }
+
+    void StatsModel::setStats(const TableStatsPtr& stats)
+    {
+        int rows = 0;
+        int columns = 0;
+        if (stats)
+        {
+            bool histogram = std::any_of(stats->columns.begin(), stats->columns.end(), [](const ColumnStats& it) {
+                return !it.histogram.empty();
+            });
+            rows = histogram ? RowHistogram + 1 : RowHistogram;
+            columns = (int)stats->columns.size();
+        }
+
+        // the shape changes rarely, a new schema or the histogram turned on or off
+        bool reshape = (rows != this->rows_) || (columns != this->columns_);
+        if (reshape)
+            beginResetModel();
+        this->stats_ = stats;
+        this->rows_ = rows;
+        this->columns_ = columns;
+        if (reshape)
+            endResetModel();
+        else if (rows > 0 && columns > 0)
+            emit dataChanged(index(0, 0), index(rows - 1, columns - 1));
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef STATS_MODEL_H
+#define STATS_MODEL_H
+
+#include <QAbstractTableModel>
+#include "column_stats.h"
+
+namespace tool
+{
+    // read only footer model, one row per statistic (count, min, max, sum, mean, stddev and the
+    // histogram if the stats have one), one column per table column
+    class StatsModel : public QAbstractTableModel
+    {
+    public:
+        StatsModel(QObject* parent = 0);
+        ~StatsModel();
+
+        virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+        virtual int columnCount(const QModelIndex& parent = QModelIndex()) const;
+        virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+        virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+        virtual Qt::ItemFlags flags(const QModelIndex& index) const;
+
+        // show stats, the rows and columns follow it
+        void setStats(const TableStatsPtr& stats);
+        const TableStatsPtr& stats() const { return stats_; }
+
+    private:
+        TableStatsPtr stats_;
+        int rows_ = 0;
+        int columns_ = 0;
+    };
+}
+
+#endif // STATS_MODEL_H
@@ -0,0 +1,283 @@
+#include "table_model.h"
+#include "row_format.h"
+
+namespace tool
+{
+    namespace
+    {
+        QString cell_string(const Column& column, size_t row, int decimals)
+        {
+            if (ColumnType::String == column.type())
+                return QString::fromStdString(column.values<std::string>()[row]);
+            char buffer[cell_text_max];
+            char* end = format_cell(buffer, buffer + sizeof(buffer), column, row, decimals);
+            return QString::fromLatin1(buffer, (int)(end - buffer));
+        }
+    }
+
+    TableModel::TableModel(int col, QObject* parent)
+        :QAbstractTableModel(parent)
+        , columns_(col)
+    {
+        for (int i = 0; i < this->columns_; i++)
+        {
+            this->titles_.push_back(QString("col %1").arg(i));
+        }
+    }
+
+    TableModel::~TableModel()
+    {
+    }
+
+    int TableModel::rowCount(const QModelIndex& parent) const
+    {
+        if (parent.isValid())
+            return 0;
+        return this->rows_;
+    }
+
+    int TableModel::columnCount(const QModelIndex& parent) const
+    {
+        if (parent.isValid())
+            return 0;
+        return this->columns_;
+    }
+
+    QVariant TableModel::data(const QModelIndex& index, int role) const
+    {
+        if (!index.isValid())
+            return QVariant();
+        if ((Qt::DisplayRole != role) && (Qt::EditRole != role))
+            return QVariant();
+
+        int r = index.row();
+        const Page* page = this->page_.get();
+        if (!page || r < 0 || r >= page->size)
+            return QVariant();
+        if (r < page->sorted_first || r > page->sorted_last)
+            return QString("...");// not ordered yet
+
+        int c = index.column();
+        if (page->history_column && (c == (int)page->data->columnCount()))
+            return QVariant();// painted by the delegate
+        if (c < 0 || c >= (int)page->data->columnCount())
+            return QString("...");// no data for this column
+
+        // the numbers of the viewport are formatted already
+        const char* text = nullptr;
+        int size = 0;
+        if (cellText(r, c, text, size))
+            return QString::fromLatin1(text, size);
+
+        int data_row = dataRow(r);
+        if (data_row < 0)
+            return QVariant();
+        return cell_string(page->data->column(c), data_row, column_decimals(page->decimals, c));
+    }
+
+    bool TableModel::cellText(int row, int column, const char*& text, int& size) const
+    {
+        const Page* page = this->page_.get();
+        if (!page || row < page->first || row >= page->first + page->count || column < 0 || column >= page->columns)
+            return false;
+        if (row < page->sorted_first || row > page->sorted_last)
+            return false;
+
+        const CellText& cell = page->cells[(size_t)(row - page->first) * page->columns + column];
+        if (!cell.held)
+            return false;
+        text = cell.text;
+        size = cell.size;
+        return true;
+    }
+
+    uint32_t TableModel::cellChange(int row, int column) const
+    {
+        const Page* page = this->page_.get();
+        if (!page || page->changed.empty() || row < page->first || row >= page->first + page->count || column < 0 || column >= page->columns)
+            return 0;
+
+        size_t i = (size_t)(row - page->first) * page->columns + column;
+        if (!(page->changed[i / 64] & (1ull << (i % 64))))
+            return 0;
+        return page->change_ms[i];
+    }
+
+    bool TableModel::cellHistory(int row, int column, const float*& values, int& size) const
+    {
+        const Page* page = this->page_.get();
+        if (!page || !page->history_column || column != page->columns || row < page->first || row >= page->first + page->count)
+            return false;
+
+        size = page->history_sizes[row - page->first];
+        if (!size)
+            return false;
+        values = &page->history[(size_t)(row - page->first) * page->history_depth];
+        return true;
+    }
+
+    QVariant TableModel::headerData(int section, Qt::Orientation orientation, int role) const
+    {
+        if (Qt::DisplayRole != role)
+            return QVariant();
+
+        if (Qt::Horizontal == orientation)
+        {
+            if (section < 0 || section >= (int)this->titles_.size())
+                return QVariant();
+            for (size_t i = 0; i < this->sort_keys_.size(); i++)
+            {
+                if (section != this->sort_keys_[i].column)
+                    continue;
+                QString label = this->sort_keys_[i].ascend ? " ^" : " v";
+                if (this->sort_keys_.size() > 1)
+                    label += QString::number((int)i + 1);
+                return this->titles_[section] + label;
+            }
+            return this->titles_[section];
+        }
+        return section + 1;
+    }
+
+    bool TableModel::setHeaderData(int section, Qt::Orientation orientation, const QVariant& value, int role)
+    {
+        if ((Qt::Horizontal != orientation) || ((Qt::DisplayRole != role) && (Qt::EditRole != role)))
+            return false;
+        if (section < 0 || section >= (int)this->titles_.size())
+            return false;
+
+        this->titles_[section] = value.toString();
+        emit headerDataChanged(orientation, section, section);
+        return true;
+    }
+
+    Qt::ItemFlags TableModel::flags(const QModelIndex& index) const
+    {
+        if (!index.isValid())
+            return Qt::NoItemFlags;
+        return Qt::ItemIsSelectable | Qt::ItemIsEnabled;// read only
+    }
+
+    int TableModel::dataRow(int row) const
+    {
+        const Page* page = this->page_.get();
+        if (!page || row < 0 || row >= (int)page->index->size())
+            return -1;
+
+        size_t rr = (*page->index)[row];
+        if (page->rows)
+        {
+            if (rr >= page->rows->size())
+                return -1;
+            rr = (*page->rows)[rr];
+        }
+        if (rr >= page->data->rowCount())
+            return -1;
+        return (int)rr;
+    }
+
+    void TableModel::setPage(const PagePtr& page)
+    {
+        if (page && ((page->data->schema() != this->schema_) || (page->history_column != this->history_column_)))
+            setSchema(page->data->schema(), page->history_column);
+        this->page_ = page;
+    }
+
+    const ColumnTablePtr& TableModel::snapshot() const
+    {
+        static const ColumnTablePtr none;
+        return this->page_ ? this->page_->data : none;
+    }
+
+    const std::vector<size_t>& TableModel::permutation() const
+    {
+        static const std::vector<size_t> none;
+        return this->page_ ? *this->page_->index : none;
+    }
+
+    const RowSetPtr& TableModel::rowSet() const
+    {
+        static const RowSetPtr none;
+        return this->page_ ? this->page_->rows : none;
+    }
+
+    int TableModel::sortedFirst() const
+    {
+        return this->page_ ? this->page_->sorted_first : 0;
+    }
+
+    int TableModel::sortedLast() const
+    {
+        return this->page_ ? this->page_->sorted_last : -1;
+    }
+
+    void TableModel::setSchema(const Schema& schema, int history_column)
+    {
+        int columns = (int)schema.size() + ((history_column && (history_column < (int)schema.size())) ? 1 : 0);
+        if (columns > this->columns_)
+        {
+            beginInsertColumns(QModelIndex(), this->columns_, columns - 1);
+            this->columns_ = columns;
+            this->titles_.resize(columns);
+            endInsertColumns();
+        }
+        else if (columns < this->columns_)
+        {
+            beginRemoveColumns(QModelIndex(), columns, this->columns_ - 1);
+            this->columns_ = columns;
+            this->titles_.resize(columns);
+            endRemoveColumns();
+        }
+
+        for (int c = 0; c < (int)schema.size(); c++)
+            this->titles_[c] = QString::fromStdString(schema[c].name);
+        if (columns > (int)schema.size())
+            this->titles_[schema.size()] = QString::fromStdString(schema[history_column].name + " history");
+        this->schema_ = schema;
+        this->history_column_ = history_column;
+        if (columns > 0)
+            emit headerDataChanged(Qt::Horizontal, 0, columns - 1);
+    }
+
+    void TableModel::setRows(int rows)
+    {
+        if (rows < 0)
+            rows = 0;
+        if (rows == this->rows_)
+            return;
+
+        if (rows > this->rows_)// rows appended at the end
+        {
+            beginInsertRows(QModelIndex(), this->rows_, rows - 1);
+            this->rows_ = rows;
+            endInsertRows();
+        }
+        else// rows dropped from the end
+        {
+            beginRemoveRows(QModelIndex(), rows, this->rows_ - 1);
+            this->rows_ = rows;
+            endRemoveRows();
+        }
+    }
+
+    void TableModel::refreshRows(int first, int last)
+    {
+        if (first < 0)
+            first = 0;
+        if (last >= this->rows_)
+            last = this->rows_ - 1;
+        if (first > last || this->columns_ <= 0)
+            return;
+
+        emit dataChanged(index(first, 0), index(last, this->columns_ - 1));
+    }
+
+    void TableModel::setSortKeys(const SortKeys& keys)
+    {
+        if (keys == this->sort_keys_)
+            return;
+        this->sort_keys_ = keys;
+        if (this->columns_ > 0)
+            emit headerDataChanged(Qt::Horizontal, 0, this->columns_ - 1);
+    }
+}
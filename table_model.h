@@ -0,0 +1,83 @@
+#ifndef TABLE_MODEL_H
+#define TABLE_MODEL_H
+
+#include <QAbstractTableModel>
+#include <vector>
+#include "column_table.h"
+#include "page_builder.h"
+#include "sort_key.h"
+
+namespace tool
+{
+    // read only model of the page on display, the cells of the viewport come formatted with the page,
+    // rows scrolled to before the next page are read from its snapshot through the sort permutation.
+    // a page with history (Page::history_column) gets one more column for the sparklines, it has no text
+    class TableModel : public QAbstractTableModel
+    {
+    public:
+        TableModel(int col, QObject* parent = 0);
+        ~TableModel();
+
+        virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+        virtual int columnCount(const QModelIndex& parent = QModelIndex()) const;
+        virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+        virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+        virtual bool setHeaderData(int section, Qt::Orientation orientation, const QVariant& value, int role = Qt::EditRole);
+        virtual Qt::ItemFlags flags(const QModelIndex& index) const;
+
+        // replace the page, the columns and titles follow the schema of its snapshot
+        void setPage(const PagePtr& page);
+        const PagePtr& page() const { return page_; }
+
+        // of the page: index is the sort permutation (row -> data position), with rows (ROI mode or
+        // a filter) it holds positions in rows, the data position is rows[index[row]]
+        const ColumnTablePtr& snapshot() const;
+        const std::vector<size_t>& permutation() const;
+        const RowSetPtr& rowSet() const;
+
+        // rows of the permutation in order, the others show "..."
+        int sortedFirst() const;
+        int sortedLast() const;
+
+        // data position of a view row, -1 if there is none
+        int dataRow(int row) const;
+
+        // the text of a number cell formatted with the page, false if the page does not hold it
+        // (out of the viewport, a string, not ordered yet). text is valid until the next setPage
+        bool cellText(int row, int column, const char*& text, int& size) const;
+
+        // the time (change_clock_ms) a cell of the viewport changed, 0 if the page has no change for it
+        // in the fade of its request
+        uint32_t cellChange(int row, int column) const;
+
+        // the last values of a row of the viewport in the history column, oldest first. false for another
+        // column or a row the page has no history for. values is valid until the next setPage
+        bool cellHistory(int row, int column, const float*& values, int& size) const;
+
+        // insert or remove rows at the end so that the row count is rows, one signal pair whatever the difference
+        void setRows(int rows);
+
+        // tell the view rows [first, last] are changed
+        void refreshRows(int first, int last);
+
+        // the titles of the sort columns get the ^ or v label, followed by their priority
+        // when there are several keys: "v1 ^1", "v3 v2"
+        void setSortKeys(const SortKeys& keys);
+
+    private:
+        // the columns of schema, followed by the history column of history_column if not 0
+        void setSchema(const Schema& schema, int history_column);
+
+        int rows_ = 0;
+        int columns_ = 0;
+        std::vector<QString> titles_;
+        Schema schema_;
+        int history_column_ = 0;
+
+        SortKeys sort_keys_;
+
+        PagePtr page_;
+    };
+}
+
+#endif // TABLE_MODEL_H
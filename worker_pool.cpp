@@ -0,0 +1,231 @@
+#include "worker_pool.h"
+#include <algorithm>
+
+namespace tool
+{
+    namespace
+    {
+        // the pool and index of a worker thread, for parallel() to queue on the own deque
+        thread_local const WorkerPool* current_pool = nullptr;
+        thread_local unsigned current_worker = 0;
+    }
+
+    void WorkerPool::Batch::work()
+    {
+        unsigned c;
+        while ((c = this->next.fetch_add(1)) < this->chunks)
+        {
+            (*this->f)(c);
+            if (this->done.fetch_add(1) + 1 == this->chunks)
+            {
+                std::lock_guard<std::mutex> lock(this->lock);
+                this->finished.notify_all();
+            }
+        }
+    }
+
+    WorkerPool::Group::Group(WorkerPool& pool)
+        : pool_(pool)
+    {
+        std::lock_guard<std::mutex> lock(this->pool_.lock_);
+        this->pool_.groups_.push_back(this);
+    }
+
+    WorkerPool::Group::~Group()
+    {
+        // the dropped tasks are destroyed out of the lock, they may hold anything
+        std::deque<Task> dropped;
+        std::unique_lock<std::mutex> lock(this->pool_.lock_);
+        std::vector<Group*>& groups = this->pool_.groups_;
+        groups.erase(std::remove(groups.begin(), groups.end(), this), groups.end());
+        dropped.swap(this->tasks_);
+        this->pool_.idle_.wait(lock, [this]() { return 0 == this->running_; });
+    }
+
+    void WorkerPool::Group::submit(Task task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->pool_.lock_);
+            this->tasks_.push_back(std::move(task));
+        }
+        this->pool_.wake_.notify_one();
+    }
+
+    void WorkerPool::Group::setPriority(WorkPriority priority)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->pool_.lock_);
+            this->priority_ = priority;
+        }
+        if (WorkPriority::Paused != priority)
+            this->pool_.wake_.notify_all();// its waiting tasks can run
+    }
+
+    WorkPriority WorkerPool::Group::priority() const
+    {
+        std::lock_guard<std::mutex> lock(this->pool_.lock_);
+        return this->priority_;
+    }
+
+    size_t WorkerPool::Group::pending() const
+    {
+        std::lock_guard<std::mutex> lock(this->pool_.lock_);
+        return this->tasks_.size();
+    }
+
+    WorkerPool::WorkerPool(unsigned threads)
+    {
+        if (!threads)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned t = 0; t <= threads; t++)
+            this->queues_.emplace_back(new StealQueue());
+        for (unsigned t = 0; t < threads; t++)
+            this->threads_.emplace_back(&WorkerPool::run, this, t);
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->lock_);
+            this->stop_ = true;
+        }
+        this->wake_.notify_all();
+        for (auto& it : this->threads_)
+            it.join();
+    }
+
+    WorkerPool& WorkerPool::shared()
+    {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    WorkerPool::GroupPtr WorkerPool::createGroup()
+    {
+        return std::make_shared<Group>(*this);
+    }
+
+    void WorkerPool::parallel(unsigned chunks, const std::function<void(unsigned)>& f)
+    {
+        if (chunks <= 1)
+        {
+            if (chunks)
+                f(0u);
+            return;
+        }
+
+        BatchPtr batch = std::make_shared<Batch>();
+        batch->f = &f;
+        batch->chunks = chunks;
+
+        // one entry per worker that may help, a worker queues on its own deque, other threads on the last one
+        unsigned helpers = std::min(chunks - 1, size());
+        StealQueue& queue = *this->queues_[(this == current_pool) ? current_worker : size()];
+        {
+            // counted before a thief can see them, a steal never takes the count below zero
+            std::lock_guard<std::mutex> lock(queue.lock);
+            this->stealable_ += helpers;
+            for (unsigned i = 0; i < helpers; i++)
+                queue.batches.push_back(batch);
+        }
+        {
+            // a worker between its check and its wait sees the batch
+            std::lock_guard<std::mutex> lock(this->lock_);
+        }
+        if (1 == helpers)
+            this->wake_.notify_one();
+        else
+            this->wake_.notify_all();
+
+        batch->work();
+        std::unique_lock<std::mutex> lock(batch->lock);
+        batch->finished.wait(lock, [&batch, chunks]() { return batch->done.load() == chunks; });
+    }
+
+    WorkerPool::BatchPtr WorkerPool::steal(unsigned worker)
+    {
+        {
+            StealQueue& own = *this->queues_[worker];
+            std::lock_guard<std::mutex> lock(own.lock);
+            if (!own.batches.empty())
+            {
+                BatchPtr batch = std::move(own.batches.back());
+                own.batches.pop_back();
+                this->stealable_--;
+                return batch;
+            }
+        }
+        for (size_t i = 1; i < this->queues_.size(); i++)
+        {
+            StealQueue& other = *this->queues_[(worker + i) % this->queues_.size()];
+            std::lock_guard<std::mutex> lock(other.lock);
+            if (!other.batches.empty())
+            {
+                BatchPtr batch = std::move(other.batches.front());
+                other.batches.pop_front();
+                this->stealable_--;
+                return batch;
+            }
+        }
+        return BatchPtr();
+    }
+
+    WorkerPool::Group* WorkerPool::nextGroup()
+    {
+        Group* best = nullptr;
+        size_t best_index = 0;
+        size_t count = this->groups_.size();
+        for (size_t i = 1; i <= count; i++)
+        {
+            size_t k = (this->turn_ + i) % count;
+            Group* group = this->groups_[k];
+            if (group->tasks_.empty() || (WorkPriority::Paused == group->priority_))
+                continue;
+            if (!best || (group->priority_ > best->priority_))
+            {
+                best = group;
+                best_index = k;
+            }
+        }
+        if (best)
+            this->turn_ = best_index;
+        return best;
+    }
+
+    void WorkerPool::run(unsigned worker)
+    {
+        current_pool = this;
+        current_worker = worker;
+
+        std::unique_lock<std::mutex> lock(this->lock_);
+        while (true)
+        {
+            // chunks first, a thread is waiting for them
+            if (this->stealable_.load())
+            {
+                lock.unlock();
+                if (BatchPtr batch = steal(worker))
+                    batch->work();
+                lock.lock();
+                continue;
+            }
+            if (this->stop_)
+                return;
+
+            if (Group* group = nextGroup())
+            {
+                Task task = std::move(group->tasks_.front());
+                group->tasks_.pop_front();
+                group->running_++;
+                lock.unlock();
+                task();
+                task = nullptr;// what it holds goes out of the lock
+                lock.lock();
+                group->running_--;
+                this->idle_.notify_all();
+                continue;
+            }
+            this->wake_.wait(lock);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tool
+{
+    // share of the pool a group gets
+    enum class WorkPriority
+    {
+        Paused,// nothing runs, the tasks wait (hidden or minimised widget)
+        Background,// visible, its window is not active
+        Visible,// in the active window
+    };
+
+    // process-wide threads shared by all SpreadSheet instances, one per core, idle ones sleep.
+    // tasks are queued per Group (one per widget) and taken from the groups of the highest priority
+    // first, in turns between groups of the same priority. parallel() splits a loop into chunks, the
+    // idle workers steal them from the caller, they go before any queued task. thread safe
+    class WorkerPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        // tasks of one owner, in the order submitted (several may run at once). the owner sets the
+        // priority, destroying the group drops its queued tasks and waits for the running ones
+        class Group
+        {
+        public:
+            explicit Group(WorkerPool& pool);
+            ~Group();
+
+            Group(const Group&) = delete;
+            Group& operator=(const Group&) = delete;
+
+            void submit(Task task);
+
+            void setPriority(WorkPriority priority);
+            WorkPriority priority() const;
+
+            // tasks queued and not started
+            size_t pending() const;
+
+        private:
+            friend class WorkerPool;
+            WorkerPool& pool_;
+            WorkPriority priority_ = WorkPriority::Visible;
+            std::deque<Task> tasks_;// under pool_.lock_
+            unsigned running_ = 0;
+        };
+        using GroupPtr = std::shared_ptr<Group>;
+
+        // threads 0 is one per core
+        explicit WorkerPool(unsigned threads = 0);
+        ~WorkerPool();// waits for the running tasks, the queued ones are dropped
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        // the pool of the process
+        static WorkerPool& shared();
+
+        unsigned size() const { return (unsigned)threads_.size(); }
+
+        GroupPtr createGroup();
+
+        // run f(c) for c in [0, chunks) and return when all are done. the caller runs chunks too, those
+        // no worker took are run by it, a full pool only makes it slower. may be called from a task or a chunk
+        void parallel(unsigned chunks, const std::function<void(unsigned)>& f);
+
+    private:
+        // chunks of one parallel call, claimed one by one by the caller and the workers holding it
+        typedef struct Batch {
+            const std::function<void(unsigned)>* f = nullptr;
+            unsigned chunks = 0;
+            std::atomic<unsigned> next{ 0 };
+            std::atomic<unsigned> done{ 0 };
+            std::mutex lock;
+            std::condition_variable finished;
+
+            void work();
+        }Batch;
+        using BatchPtr = std::shared_ptr<Batch>;
+
+        // one per worker and a last one for the threads out of the pool
+        typedef struct StealQueue {
+            std::mutex lock;
+            std::deque<BatchPtr> batches;
+        }StealQueue;
+
+        void run(unsigned worker);
+
+        // the newest batch of the own queue, else the oldest of another one
+        BatchPtr steal(unsigned worker);
+
+        // next group to take a task from, under lock_
+        Group* nextGroup();
+
+        std::vector<std::unique_ptr<StealQueue> > queues_;
+        std::atomic<size_t> stealable_{ 0 };// batches in queues_
+
+        std::mutex lock_;
+        std::condition_variable wake_;// workers: a batch, a task or stop
+        std::condition_variable idle_;// ~Group: a task of it ended
+        std::vector<Group*> groups_;
+        size_t turn_ = 0;// the group after it is asked first
+        bool stop_ = false;
+        std::vector<std::thread> threads_;
+    };
+}
+
+#endif // WORKER_POOL_H